@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+	parameters:
+	a0 - pointer to array of struct { xlen size_in_result_out, xlen addr },
+	     terminated by a zero size
+	a1 - value to check, a 32 bit word sign extended to xlen
+
+	Assemble with XLEN defined as 32 or 64.
+	Only uses registers available in RV32E.
+*/
+
+	.text
+	.option norvc
+
+	.if XLEN == 64
+	.macro LREG rd, off, base
+	ld	\rd, \off(\base)
+	.endm
+	.macro SREG rs, off, base
+	sd	\rs, \off(\base)
+	.endm
+	.else
+	.macro LREG rd, off, base
+	lw	\rd, \off(\base)
+	.endm
+	.macro SREG rs, off, base
+	sw	\rs, \off(\base)
+	.endm
+	.endif
+
+BLOCK_SIZE_RESULT	= 0
+BLOCK_ADDRESS		= XLEN / 8
+SIZEOF_STRUCT_BLOCK	= 2 * XLEN / 8
+
+start:
+block_loop:
+	/* get size in words */
+	LREG	a2, BLOCK_SIZE_RESULT, a0
+	beqz	a2, done
+
+	/* get address */
+	LREG	a3, BLOCK_ADDRESS, a0
+
+word_loop:
+	lw	a4, 0(a3)			/* read word */
+	addi	a3, a3, 4
+
+	bne	a4, a1, not_erased
+
+	addi	a2, a2, -1
+	bnez	a2, word_loop
+
+	li	a4, 1				/* block is erased */
+save_result:
+	SREG	a4, BLOCK_SIZE_RESULT, a0
+	addi	a0, a0, SIZEOF_STRUCT_BLOCK
+	j	block_loop
+
+not_erased:
+	li	a4, 0
+	j	save_result
+
+done:
+	ebreak
@@ -25,6 +25,9 @@
   Or if you want to test UNIX sockets, run both on Raspberry Pi:
   socat UNIX-LISTEN:/tmp/remotebitbang-socket,fork EXEC:"sudo ./remote_bitbang_sysfsgpio tck 11 tms 25 tdo 9 tdi 10"
   openocd -c "interface remote_bitbang; remote_bitbang host /tmp/remotebitbang-socket" -f target/stm32f1x.cfg
+
+  Add "remote_bitbang binary on" to the configuration to send the scans with
+  the binary protocol extension, which is understood by this server too.
 */
 
 #include <sys/types.h>
@@ -280,6 +283,68 @@ static void cleanup_all_fds(void)
 	cleanup_fd(srst_fd, srst_gpio);
 }
 
+/*
+ * Binary protocol extension: clock a vector of bits
+ *
+ * The command is followed by a byte of flags, the number of bits as 32 bit
+ * little endian, then the packed TMS and TDI vectors when their flags are set.
+ * For each bit TCK is set low with TMS and TDI, TDO is sampled and TCK is set
+ * high. When requested, the TDO vector is sent back packed the same way.
+ */
+#define VECTOR_TMS	0x01
+#define VECTOR_TDI	0x02
+#define VECTOR_TDO	0x04
+
+static int read_bytes(unsigned char *buf, size_t len)
+{
+	return fread(buf, 1, len, stdin) == len ? ERROR_OK : ERROR_FAIL;
+}
+
+static int process_vector(void)
+{
+	unsigned char header[5];
+	if (read_bytes(header, sizeof(header)) != ERROR_OK)
+		return ERROR_FAIL;
+
+	int flags = header[0];
+	unsigned long num_bits = header[1] | header[2] << 8 |
+		(unsigned long)header[3] << 16 | (unsigned long)header[4] << 24;
+	size_t len = (num_bits + 7) / 8;
+
+	unsigned char *tms = calloc(len + 1, 1);
+	unsigned char *tdi = calloc(len + 1, 1);
+	unsigned char *tdo = calloc(len + 1, 1);
+	int ret = ERROR_FAIL;
+
+	if (!tms || !tdi || !tdo) {
+		LOG_ERROR("Out of memory");
+		goto out;
+	}
+
+	if ((flags & VECTOR_TMS) && read_bytes(tms, len) != ERROR_OK)
+		goto out;
+	if ((flags & VECTOR_TDI) && read_bytes(tdi, len) != ERROR_OK)
+		goto out;
+
+	for (unsigned long i = 0; i < num_bits; i++) {
+		int tms_bit = (tms[i / 8] >> (i % 8)) & 1;
+		int tdi_bit = (tdi[i / 8] >> (i % 8)) & 1;
+
+		sysfsgpio_write(0, tms_bit, tdi_bit);
+		if ((flags & VECTOR_TDO) && sysfsgpio_read() == '1')
+			tdo[i / 8] |= 1 << (i % 8);
+		sysfsgpio_write(1, tms_bit, tdi_bit);
+	}
+
+	if (!(flags & VECTOR_TDO) || fwrite(tdo, 1, len, stdout) == len)
+		ret = ERROR_OK;
+out:
+	free(tms);
+	free(tdi);
+	free(tdo);
+	return ret;
+}
+
 static void process_remote_protocol(void)
 {
 	int c;
@@ -298,10 +363,18 @@ static void process_remote_protocol(void)
 			sysfsgpio_write(!!(d & 4),
 					!!(d & 2),
 					(d & 1));
-		} else if (c == 'R')
+		} else if (c == 'R') {
 			putchar(sysfsgpio_read());
-		else
+		} else if (c == 'V') { /* Version of the binary protocol */
+			fputs("V1", stdout);
+		} else if (c == 'X') { /* Vector */
+			if (process_vector() != ERROR_OK) {
+				LOG_ERROR("Vector command failed");
+				break;
+			}
+		} else {
 			LOG_ERROR("Unknown command '%c' received", c);
+		}
 	}
 }
 
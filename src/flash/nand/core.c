@@ -246,6 +246,35 @@ int nand_build_bbt(struct nand_device *nand, int first, int last)
 	return ERROR_OK;
 }
 
+int nand_skip_bad_blocks(struct nand_device *nand, uint32_t *page)
+{
+	if (!nand->device)
+		return ERROR_NAND_DEVICE_NOT_PROBED;
+
+	uint32_t pages_per_block = nand->erase_size / nand->page_size;
+	int block = *page / pages_per_block;
+
+	for (; block < nand->num_blocks; block++) {
+		/* only blocks never checked cost a round-trip to the device */
+		if (nand->blocks[block].is_bad == -1) {
+			int retval = nand_build_bbt(nand, block, block);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+
+		if (nand->blocks[block].is_bad != 1) {
+			if (block != (int)(*page / pages_per_block))
+				*page = block * pages_per_block;
+			return ERROR_OK;
+		}
+
+		LOG_INFO("skipping bad block %d", block);
+	}
+
+	LOG_ERROR("no good block left on NAND device");
+	return ERROR_NAND_OPERATION_FAILED;
+}
+
 int nand_read_status(struct nand_device *nand, uint8_t *status)
 {
 	if (!nand->device)
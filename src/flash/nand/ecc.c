@@ -42,30 +42,58 @@ static const uint8_t nand_ecc_precalc_table[] = {
 	0x00, 0x55, 0x56, 0x03, 0x59, 0x0c, 0x0f, 0x5a, 0x5a, 0x0f, 0x0c, 0x59, 0x03, 0x56, 0x55, 0x00
 };
 
+static inline uint8_t parity32(uint32_t v)
+{
+	v ^= v >> 16;
+	v ^= v >> 8;
+	v ^= v >> 4;
+	v ^= v >> 2;
+	v ^= v >> 1;
+	return v & 1;
+}
+
 /*
  * nand_calculate_ecc - Calculate 3-byte ECC for 256-byte block
+ *
+ * Bit n of the line parity is the parity of all the bytes whose index has
+ * bit n set. The block is thus folded 32 bits at a time: bits 2..7 come from
+ * the words whose index has bit 0..5 set, bits 0..1 from the bytes of the
+ * XOR of all the words, which also gives the column parity.
  */
 int nand_calculate_ecc(struct nand_device *nand, const uint8_t *dat, uint8_t *ecc_code)
 {
+	uint32_t all = 0, line[6] = { 0 };
 	uint8_t idx, reg1, reg2, reg3, tmp1, tmp2;
-	int i;
-
-	/* Initialize variables */
-	reg1 = reg2 = reg3 = 0;
-
-	/* Build up column parity */
-	for (i = 0; i < 256; i++) {
-		/* Get CP0 - CP5 from table */
-		idx = nand_ecc_precalc_table[*dat++];
-		reg1 ^= (idx & 0x3f);
-
-		/* All bit XOR = 1 ? */
-		if (idx & 0x40) {
-			reg3 ^= (uint8_t) i;
-			reg2 ^= ~((uint8_t) i);
-		}
+	int i, j;
+
+	/* Fold groups of four words, bits 0..1 of the word index are
+	 * fixed inside a group and bits 2..5 are those of the group */
+	for (i = 0; i < 16; i++, dat += 16) {
+		uint32_t w0 = le_to_h_u32(dat);
+		uint32_t w1 = le_to_h_u32(dat + 4);
+		uint32_t w2 = le_to_h_u32(dat + 8);
+		uint32_t w3 = le_to_h_u32(dat + 12);
+		uint32_t group = w0 ^ w1 ^ w2 ^ w3;
+
+		line[0] ^= w1 ^ w3;
+		line[1] ^= w2 ^ w3;
+		all ^= group;
+		for (j = 0; j < 4; j++)
+			if (i & (1 << j))
+				line[j + 2] ^= group;
 	}
 
+	/* Get CP0 - CP5 and the XOR of all bits from table */
+	idx = nand_ecc_precalc_table[(all ^ (all >> 8) ^ (all >> 16) ^ (all >> 24)) & 0xff];
+	reg1 = idx & 0x3f;
+
+	reg3 = parity32(all & 0xff00ff00) | (parity32(all & 0xffff0000) << 1);
+	for (j = 0; j < 6; j++)
+		reg3 |= parity32(line[j]) << (j + 2);
+
+	/* odd parity bytes contribute their inverted index, too */
+	reg2 = (idx & 0x40) ? ~reg3 : reg3;
+
 	/* Create non-inverted ECC code from line parity */
 	tmp1  = (reg3 & 0x80) >> 0; /* B7 -> B7 */
 	tmp1 |= (reg2 & 0x80) >> 1; /* B7 -> B6 */
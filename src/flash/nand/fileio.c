@@ -13,6 +13,7 @@
 #endif
 
 #include "core.h"
+#include "imp.h"
 #include "fileio.h"
 
 static struct nand_ecclayout nand_oob_16 = {
@@ -140,6 +141,8 @@ COMMAND_HELPER(nand_fileio_parse_args, struct nand_fileio_state *state,
 				state->oob_format |= NAND_OOB_SW_ECC;
 			else if (sw_ecc && !strcmp(CMD_ARGV[i], "oob_softecc_kw"))
 				state->oob_format |= NAND_OOB_SW_ECC_KW;
+			else if (!strcmp(CMD_ARGV[i], "skip_bad"))
+				state->skip_bad = true;
 			else {
 				command_print(CMD, "unknown option: %s", CMD_ARGV[i]);
 				return ERROR_COMMAND_SYNTAX_ERROR;
@@ -210,3 +213,20 @@ int nand_fileio_read(struct nand_device *nand, struct nand_fileio_state *s)
 	}
 	return total_read;
 }
+
+/**
+ * Move the address of @a s past the bad blocks, if requested.
+ */
+int nand_fileio_skip_bad(struct nand_device *nand, struct nand_fileio_state *s)
+{
+	if (!s->skip_bad)
+		return ERROR_OK;
+
+	uint32_t page = s->address / nand->page_size;
+	int retval = nand_skip_bad_blocks(nand, &page);
+	if (retval != ERROR_OK)
+		return retval;
+
+	s->address = page * nand->page_size;
+	return ERROR_OK;
+}
@@ -23,6 +23,9 @@ struct nand_fileio_state {
 
 	const int *eccpos;
 
+	/* skip the bad blocks instead of accessing them */
+	bool skip_bad;
+
 	bool file_opened;
 	struct fileio *fileio;
 
@@ -41,5 +44,6 @@ COMMAND_HELPER(nand_fileio_parse_args, struct nand_fileio_state *state,
 	bool need_size, bool sw_ecc);
 
 int nand_fileio_read(struct nand_device *nand, struct nand_fileio_state *s);
+int nand_fileio_skip_bad(struct nand_device *nand, struct nand_fileio_state *s);
 
 #endif /* OPENOCD_FLASH_NAND_FILEIO_H */
@@ -24,4 +24,11 @@ int nand_probe(struct nand_device *nand);
 int nand_erase(struct nand_device *nand, int first_block, int last_block);
 int nand_build_bbt(struct nand_device *nand, int first, int last);
 
+/**
+ * Move @a page to the first page of the next good block if it lies in a
+ * bad block. The bad block table is consulted and only built for blocks
+ * which were not checked yet.
+ */
+int nand_skip_bad_blocks(struct nand_device *nand, uint32_t *page);
+
 #endif /* OPENOCD_FLASH_NAND_IMP_H */
@@ -17,6 +17,9 @@
 #include "fileio.h"
 #include <target/target.h>
 
+/* bytes of pages and OOB gathered before writing them to the file */
+#define NAND_DUMP_BATCH_SIZE	(64 * 1024)
+
 COMMAND_HANDLER(handle_nand_list_command)
 {
 	struct nand_device *p;
@@ -245,8 +248,10 @@ COMMAND_HANDLER(handle_nand_write_command)
 		}
 		s.size -= bytes_read;
 
-		retval = nand_write_page(nand, s.address / nand->page_size,
-				s.page, s.page_size, s.oob, s.oob_size);
+		retval = nand_fileio_skip_bad(nand, &s);
+		if (retval == ERROR_OK)
+			retval = nand_write_page(nand, s.address / nand->page_size,
+					s.page, s.page_size, s.oob, s.oob_size);
 		if (retval != ERROR_OK) {
 			command_print(CMD, "failed writing file %s "
 				"to NAND flash %s at offset 0x%8.8" PRIx32,
@@ -284,9 +289,12 @@ COMMAND_HANDLER(handle_nand_verify_command)
 	if (retval != ERROR_OK)
 		return retval;
 
+	dev.skip_bad = file.skip_bad;
 	while (file.size > 0) {
-		retval = nand_read_page(nand, dev.address / dev.page_size,
-				dev.page, dev.page_size, dev.oob, dev.oob_size);
+		retval = nand_fileio_skip_bad(nand, &dev);
+		if (retval == ERROR_OK)
+			retval = nand_read_page(nand, dev.address / nand->page_size,
+					dev.page, dev.page_size, dev.oob, dev.oob_size);
 		if (retval != ERROR_OK) {
 			command_print(CMD, "reading NAND flash page failed");
 			nand_fileio_cleanup(&dev);
@@ -335,29 +343,58 @@ COMMAND_HANDLER(handle_nand_dump_command)
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* pages are gathered in a buffer, to write the file in large chunks */
+	uint32_t stride = s.page_size + s.oob_size;
+	uint32_t batch = MAX(NAND_DUMP_BATCH_SIZE / stride, 1);
+	uint8_t *buffer = malloc(batch * stride);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		nand_fileio_cleanup(&s);
+		return ERROR_FAIL;
+	}
+
 	while (s.size > 0) {
+		uint8_t *p = buffer;
 		size_t size_written;
-		retval = nand_read_page(nand, s.address / nand->page_size,
-				s.page, s.page_size, s.oob, s.oob_size);
+
+		for (uint32_t i = 0; i < batch && s.size > 0; i++) {
+			retval = nand_fileio_skip_bad(nand, &s);
+			if (retval == ERROR_OK)
+				retval = nand_read_page(nand, s.address / nand->page_size,
+						s.page ? p : NULL, s.page_size,
+						s.oob ? p + s.page_size : NULL, s.oob_size);
+			if (retval != ERROR_OK) {
+				command_print(CMD, "reading NAND flash page failed");
+				free(buffer);
+				nand_fileio_cleanup(&s);
+				return retval;
+			}
+
+			p += stride;
+			s.size -= nand->page_size;
+			s.address += nand->page_size;
+		}
+
+		retval = fileio_write(s.fileio, p - buffer, buffer, &size_written);
+		if (retval == ERROR_OK && size_written != (size_t)(p - buffer))
+			retval = ERROR_FAIL;
 		if (retval != ERROR_OK) {
-			command_print(CMD, "reading NAND flash page failed");
+			command_print(CMD, "error while writing file");
+			free(buffer);
 			nand_fileio_cleanup(&s);
 			return retval;
 		}
 
-		if (s.page)
-			fileio_write(s.fileio, s.page_size, s.page, &size_written);
-
-		if (s.oob)
-			fileio_write(s.fileio, s.oob_size, s.oob, &size_written);
-
-		s.size -= nand->page_size;
-		s.address += nand->page_size;
+		keep_alive();
 	}
 
+	free(buffer);
+
 	retval = fileio_size(s.fileio, &filesize);
-	if (retval != ERROR_OK)
+	if (retval != ERROR_OK) {
+		nand_fileio_cleanup(&s);
 		return retval;
+	}
 
 	if (nand_fileio_finish(&s) == ERROR_OK) {
 		command_print(CMD, "dumped %zu bytes in %fs (%0.3f KiB/s)",
@@ -432,7 +469,7 @@ static const struct command_registration nand_exec_command_handlers[] = {
 		.handler = handle_nand_dump_command,
 		.mode = COMMAND_EXEC,
 		.usage = "bank_id filename offset length "
-			"['oob_raw'|'oob_only']",
+			"['oob_raw'|'oob_only'] ['skip_bad']",
 		.help = "dump from NAND flash device",
 	},
 	{
@@ -440,7 +477,8 @@ static const struct command_registration nand_exec_command_handlers[] = {
 		.handler = handle_nand_verify_command,
 		.mode = COMMAND_EXEC,
 		.usage = "bank_id filename offset "
-			"['oob_raw'|'oob_only'|'oob_softecc'|'oob_softecc_kw']",
+			"['oob_raw'|'oob_only'|'oob_softecc'|'oob_softecc_kw'] "
+			"['skip_bad']",
 		.help = "verify NAND flash device",
 	},
 	{
@@ -448,7 +486,8 @@ static const struct command_registration nand_exec_command_handlers[] = {
 		.handler = handle_nand_write_command,
 		.mode = COMMAND_EXEC,
 		.usage = "bank_id filename offset "
-			"['oob_raw'|'oob_only'|'oob_softecc'|'oob_softecc_kw']",
+			"['oob_raw'|'oob_only'|'oob_softecc'|'oob_softecc_kw'] "
+			"['skip_bad']",
 		.help = "write to NAND flash device",
 	},
 	{
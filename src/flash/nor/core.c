@@ -15,6 +15,7 @@
 #include <flash/common.h>
 #include <flash/nor/core.h>
 #include <flash/nor/imp.h>
+#include <helper/time_support.h>
 #include <target/image.h>
 
 /**
@@ -32,8 +33,15 @@ int flash_driver_erase(struct flash_bank *bank, unsigned int first,
 	int retval;
 
 	retval = bank->driver->erase(bank, first, last);
-	if (retval != ERROR_OK)
+	if (retval != ERROR_OK) {
 		LOG_ERROR("failed erasing sectors %u to %u", first, last);
+		if (first <= last && last < bank->num_sectors)
+			flash_fingerprint_forget(bank, bank->sectors[first].offset,
+					bank->sectors[last].offset + bank->sectors[last].size -
+					bank->sectors[first].offset);
+	} else {
+		flash_fingerprint_erased(bank, first, last);
+	}
 
 	return retval;
 }
@@ -87,6 +95,8 @@ int flash_driver_write(struct flash_bank *bank,
 {
 	int retval;
 
+	flash_fingerprint_forget(bank, offset, count);
+
 	retval = bank->driver->write(bank, buffer, offset, count);
 	if (retval != ERROR_OK) {
 		LOG_ERROR(
@@ -238,6 +248,8 @@ void flash_free_all_banks(void)
 		bank = next;
 	}
 	flash_banks = NULL;
+
+	flash_fingerprint_set_dir(NULL);
 }
 
 struct flash_bank *get_flash_bank_by_name_noprobe(const char *name)
@@ -330,10 +342,11 @@ int get_flash_bank_by_addr(struct target *target,
 	return ERROR_OK;
 }
 
-static int default_flash_mem_blank_check(struct flash_bank *bank)
+int default_flash_mem_blank_check(struct flash_bank *bank)
 {
 	struct target *target = bank->target;
-	const int buffer_size = 1024;
+	/* large reads let the adapters queue long transfers */
+	const uint32_t buffer_size = 64 * 1024;
 	uint32_t n_bytes;
 	int retval = ERROR_OK;
 
@@ -343,12 +356,18 @@ static int default_flash_mem_blank_check(struct flash_bank *bank)
 	}
 
 	uint8_t *buffer = malloc(buffer_size);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
 
 	for (unsigned int i = 0; i < bank->num_sectors; i++) {
 		uint32_t j;
 		bank->sectors[i].is_erased = 1;
 
-		for (j = 0; j < bank->sectors[i].size; j += buffer_size) {
+		/* the rest of a sector is not read once it is known not erased */
+		for (j = 0; j < bank->sectors[i].size && bank->sectors[i].is_erased == 1;
+				j += buffer_size) {
 			uint32_t chunk;
 			chunk = buffer_size;
 			if (chunk > (bank->sectors[i].size - j))
@@ -368,6 +387,7 @@ static int default_flash_mem_blank_check(struct flash_bank *bank)
 					break;
 				}
 			}
+			keep_alive();
 		}
 	}
 
@@ -727,8 +747,386 @@ static bool flash_write_check_gap(struct flash_bank *bank,
 }
 
 
+/* check if the flash at address already holds the size bytes of buffer */
+static int flash_diff_matches(struct target *target, struct flash_bank *bank,
+	const uint8_t *buffer, target_addr_t address, uint32_t size, bool *match)
+{
+	int retval;
+
+	/* sectors recorded in the fingerprint cache need no target access */
+	if (flash_fingerprint_lookup(bank, address - bank->base, buffer, size, match) == ERROR_OK)
+		return ERROR_OK;
+
+	/* memory mapped flash can be checksummed on the target */
+	if (bank->driver->read == default_flash_read) {
+		uint32_t target_crc, image_crc;
+
+		retval = target_checksum_memory(target, address, size, &target_crc);
+		if (retval == ERROR_OK) {
+			retval = image_calculate_checksum(buffer, size, &image_crc);
+			if (retval != ERROR_OK)
+				return retval;
+			*match = target_crc == image_crc;
+			return ERROR_OK;
+		}
+	}
+
+	uint8_t *data = malloc(size);
+	if (!data) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	retval = flash_driver_read(bank, data, address - bank->base, size);
+	if (retval == ERROR_OK)
+		*match = !memcmp(data, buffer, size);
+	free(data);
+
+	return retval;
+}
+
+/* unlock, erase and program the changed part of a run */
+static int flash_diff_program(struct target *target, struct flash_bank *bank,
+	const uint8_t *buffer, uint32_t offset, uint32_t size, bool unlock)
+{
+	int retval = ERROR_OK;
+
+	if (unlock)
+		retval = flash_unlock_address_range(target, bank->base + offset, size);
+	if (retval == ERROR_OK)
+		retval = flash_erase_address_range(target, true, bank->base + offset, size);
+	if (retval == ERROR_OK)
+		retval = flash_driver_write(bank, buffer, offset, size);
+
+	return retval;
+}
+
+/**
+ * Write a run of the image, erasing and programming only the sectors whose
+ * content differs from the image. Consecutive changed sectors are handled
+ * together. The whole run is compared first, so that an unchanged run
+ * takes a single checksum.
+ */
+static int flash_write_run_diff(struct target *target, struct flash_bank *bank,
+	const uint8_t *buffer, target_addr_t address, uint32_t size, bool unlock,
+	uint32_t *written, unsigned int *sectors_skipped, unsigned int *sectors_written)
+{
+	uint32_t run_start = address - bank->base;
+	uint32_t run_end = run_start + size;
+	unsigned int skipped = 0;
+	bool match;
+
+	int retval = flash_diff_matches(target, bank, buffer, address, size, &match);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* the changed sectors not programmed yet */
+	uint32_t group_start = 0;
+	uint32_t group_end = 0;
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		uint32_t start = MAX(run_start, bank->sectors[i].offset);
+		uint32_t end = MIN(run_end, bank->sectors[i].offset + bank->sectors[i].size);
+		if (start >= end)
+			continue;
+
+		if (match) {
+			skipped++;
+			continue;
+		}
+
+		bool sector_match;
+		retval = flash_diff_matches(target, bank, buffer + (start - run_start),
+				bank->base + start, end - start, &sector_match);
+		if (retval != ERROR_OK)
+			return retval;
+
+		if (!sector_match) {
+			if (group_start == group_end)
+				group_start = start;
+			group_end = end;
+			(*sectors_written)++;
+			continue;
+		}
+
+		skipped++;
+		if (group_start != group_end) {
+			retval = flash_diff_program(target, bank, buffer + (group_start - run_start),
+					group_start, group_end - group_start, unlock);
+			if (retval != ERROR_OK)
+				return retval;
+			*written += group_end - group_start;
+			group_start = group_end;
+		}
+	}
+
+	if (group_start != group_end) {
+		retval = flash_diff_program(target, bank, buffer + (group_start - run_start),
+				group_start, group_end - group_start, unlock);
+		if (retval != ERROR_OK)
+			return retval;
+		*written += group_end - group_start;
+	}
+
+	*sectors_skipped += skipped;
+
+	return ERROR_OK;
+}
+
+/* erase of a bank in the background, while other banks are programmed */
+enum flash_write_erase_state {
+	/* no section of the image in the bank */
+	FLASH_ERASE_AHEAD_NONE,
+	/* erased with its runs */
+	FLASH_ERASE_AHEAD_NO,
+	/* the sectors erase_first to erase_last are to be erased ahead */
+	FLASH_ERASE_AHEAD_PLANNED,
+	FLASH_ERASE_AHEAD_RUNNING,
+	FLASH_ERASE_AHEAD_DONE,
+};
+
+/* time spent on each flash bank by flash_write_unlock_verify() */
+struct flash_write_bank_stats {
+	uint32_t bytes;
+	/* the fingerprint cache of the bank is valid */
+	bool fingerprints;
+	enum flash_write_erase_state erase_state;
+	unsigned int erase_first;
+	unsigned int erase_last;
+	struct duration erase_bench;
+	float erase;
+	float program;
+	float verify;
+};
+
+static float flash_write_elapsed(struct duration *bench)
+{
+	if (duration_measure(bench) != ERROR_OK)
+		return 0;
+
+	float elapsed = duration_elapsed(bench);
+	duration_start(bench);
+
+	return elapsed;
+}
+
+/* Find the banks the sections of the image go to. A bank whose driver can
+ * erase in the background and whose sectors to erase are contiguous is
+ * erased ahead, if the image goes to several banks. */
+static unsigned int flash_write_plan_erases(struct target *target,
+		struct imagesection **sections, unsigned int num_sections,
+		struct flash_write_bank_stats *stats, unsigned int num_banks)
+{
+	unsigned int used = 0;
+	unsigned int planned = 0;
+
+	for (unsigned int i = 0; i < num_sections; i++) {
+		target_addr_t addr = sections[i]->base_address;
+		target_addr_t end = addr + sections[i]->size;
+
+		while (addr < end) {
+			struct flash_bank *c;
+			if (get_flash_bank_by_addr(target, addr, false, &c) != ERROR_OK || !c ||
+					c->bank_number >= num_banks)
+				break;
+
+			struct flash_write_bank_stats *bank_stats = &stats[c->bank_number];
+			uint32_t offset = addr - c->base;
+			uint32_t offset_end = MIN(end, c->base + c->size) - c->base;
+			addr = c->base + offset_end;
+
+			/* sectors holding [offset, offset_end) */
+			unsigned int first = c->num_sectors;
+			unsigned int last = 0;
+			for (unsigned int sector = 0; sector < c->num_sectors; sector++) {
+				uint32_t sector_end = c->sectors[sector].offset + c->sectors[sector].size;
+				if (sector_end <= offset || c->sectors[sector].offset >= offset_end)
+					continue;
+				first = MIN(first, sector);
+				last = sector;
+			}
+
+			if (bank_stats->erase_state == FLASH_ERASE_AHEAD_NONE) {
+				used++;
+				bank_stats->erase_state = FLASH_ERASE_AHEAD_NO;
+				if (c->driver->erase_start && c->driver->erase_poll && first <= last) {
+					bank_stats->erase_state = FLASH_ERASE_AHEAD_PLANNED;
+					bank_stats->erase_first = first;
+					bank_stats->erase_last = last;
+					planned++;
+				}
+			} else if (bank_stats->erase_state == FLASH_ERASE_AHEAD_PLANNED && first <= last) {
+				/* the runs would not erase the sectors in between */
+				if (first > bank_stats->erase_last + 1) {
+					bank_stats->erase_state = FLASH_ERASE_AHEAD_NO;
+					planned--;
+				} else {
+					bank_stats->erase_last = MAX(bank_stats->erase_last, last);
+				}
+			}
+		}
+	}
+
+	if (used > 1)
+		return planned;
+
+	for (unsigned int i = 0; i < num_banks; i++) {
+		if (stats[i].erase_state == FLASH_ERASE_AHEAD_PLANNED)
+			stats[i].erase_state = FLASH_ERASE_AHEAD_NO;
+	}
+	return 0;
+}
+
+static int flash_write_start_erases(struct target *target,
+		struct flash_write_bank_stats *stats, unsigned int num_banks, bool unlock)
+{
+	for (unsigned int i = 0; i < num_banks; i++) {
+		if (stats[i].erase_state != FLASH_ERASE_AHEAD_PLANNED)
+			continue;
+
+		struct flash_bank *bank = get_flash_bank_by_num_noprobe(i);
+		unsigned int first = stats[i].erase_first;
+		unsigned int last = stats[i].erase_last;
+		target_addr_t addr = bank->base + bank->sectors[first].offset;
+		uint32_t size = bank->sectors[last].offset + bank->sectors[last].size -
+			bank->sectors[first].offset;
+
+		int retval = ERROR_OK;
+		if (unlock)
+			retval = flash_unlock_address_range(target, addr, size);
+		if (retval == ERROR_OK) {
+			LOG_DEBUG("erasing sectors %u to %u of flash bank %u in the background",
+					first, last, i);
+			duration_start(&stats[i].erase_bench);
+			retval = bank->driver->erase_start(bank, first, last);
+		}
+		if (retval != ERROR_OK) {
+			LOG_ERROR("failed erasing sectors %u to %u", first, last);
+			flash_fingerprint_forget(bank, addr - bank->base, size);
+			stats[i].erase_state = FLASH_ERASE_AHEAD_NO;
+			return retval;
+		}
+		stats[i].erase_state = FLASH_ERASE_AHEAD_RUNNING;
+	}
+
+	return ERROR_OK;
+}
+
+/* Move the background erases on, waiting for the end of the erase of bank
+ * wait_bank, or of all the banks with wait_all. */
+static int flash_write_poll_erases(struct flash_write_bank_stats *stats,
+		unsigned int num_banks, int wait_bank, bool wait_all)
+{
+	int retval = ERROR_OK;
+
+	while (true) {
+		bool waiting = false;
+
+		for (unsigned int i = 0; i < num_banks; i++) {
+			if (stats[i].erase_state != FLASH_ERASE_AHEAD_RUNNING)
+				continue;
+
+			struct flash_bank *bank = get_flash_bank_by_num_noprobe(i);
+			bool done;
+			int poll_retval = bank->driver->erase_poll(bank, &done);
+			if (poll_retval != ERROR_OK || done) {
+				unsigned int first = stats[i].erase_first;
+				unsigned int last = stats[i].erase_last;
+
+				stats[i].erase_state = FLASH_ERASE_AHEAD_DONE;
+				if (duration_measure(&stats[i].erase_bench) == ERROR_OK)
+					stats[i].erase += duration_elapsed(&stats[i].erase_bench);
+				if (poll_retval == ERROR_OK) {
+					flash_fingerprint_erased(bank, first, last);
+				} else {
+					LOG_ERROR("failed erasing sectors %u to %u", first, last);
+					flash_fingerprint_forget(bank, bank->sectors[first].offset,
+							bank->sectors[last].offset + bank->sectors[last].size -
+							bank->sectors[first].offset);
+					if (retval == ERROR_OK)
+						retval = poll_retval;
+				}
+			} else if (wait_all || (int)i == wait_bank) {
+				waiting = true;
+			}
+		}
+
+		if (!waiting || (retval != ERROR_OK && !wait_all))
+			return retval;
+		alive_sleep(1);
+	}
+}
+
+static bool flash_write_erases_running(struct flash_write_bank_stats *stats,
+		unsigned int num_banks)
+{
+	for (unsigned int i = 0; i < num_banks; i++) {
+		if (stats[i].erase_state == FLASH_ERASE_AHEAD_RUNNING)
+			return true;
+	}
+
+	return false;
+}
+
+/* Program a run a sector at a time while other banks are erased in the
+ * background, moving their erases on in between. */
+static int flash_write_interleaved(struct flash_bank *bank, const uint8_t *buffer,
+		uint32_t offset, uint32_t size, struct flash_write_bank_stats *stats,
+		unsigned int num_banks)
+{
+	while (size) {
+		uint32_t chunk = size;
+
+		if (flash_write_erases_running(stats, num_banks)) {
+			for (unsigned int i = 0; i < bank->num_sectors; i++) {
+				uint32_t sector_end = bank->sectors[i].offset + bank->sectors[i].size;
+				if (offset < sector_end && offset >= bank->sectors[i].offset) {
+					chunk = MIN(size, sector_end - offset);
+					break;
+				}
+			}
+		}
+
+		int retval = flash_driver_write(bank, buffer, offset, chunk);
+		if (retval == ERROR_OK)
+			retval = flash_write_poll_erases(stats, num_banks, -1, false);
+		if (retval != ERROR_OK)
+			return retval;
+
+		buffer += chunk;
+		offset += chunk;
+		size -= chunk;
+	}
+
+	return ERROR_OK;
+}
+
+static void flash_write_report_stats(struct flash_write_bank_stats *stats,
+		unsigned int num_banks)
+{
+	unsigned int used = 0;
+
+	for (unsigned int i = 0; i < num_banks; i++) {
+		if (stats[i].bytes)
+			used++;
+	}
+
+	/* the totals are reported by the commands, only show the split */
+	for (unsigned int i = 0; i < num_banks; i++) {
+		if (!stats[i].bytes)
+			continue;
+
+		struct flash_bank *bank = get_flash_bank_by_num_noprobe(i);
+		log_printf_lf(used > 1 ? LOG_LVL_INFO : LOG_LVL_DEBUG,
+				__FILE__, __LINE__, __func__,
+				"flash bank %u %s: %" PRIu32 " bytes, erase %fs, program %fs, verify %fs",
+				i, bank ? bank->name : "", stats[i].bytes,
+				stats[i].erase, stats[i].program, stats[i].verify);
+	}
+}
+
 int flash_write_unlock_verify(struct target *target, struct image *image,
-	uint32_t *written, bool erase, bool unlock, bool write, bool verify)
+	uint32_t *written, bool erase, bool unlock, bool write, bool verify, bool differential)
 {
 	int retval = ERROR_OK;
 
@@ -736,6 +1134,10 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 	uint32_t section_offset;
 	struct flash_bank *c;
 	int *padding;
+	unsigned int sectors_skipped = 0;
+	unsigned int sectors_written = 0;
+	uint32_t run_written;
+	struct duration bench;
 
 	section = 0;
 	section_offset = 0;
@@ -753,6 +1155,16 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 	/* allocate padding array */
 	padding = calloc(image->num_sections, sizeof(*padding));
 
+	unsigned int num_banks = flash_get_bank_count();
+	struct flash_write_bank_stats *stats = calloc(num_banks, sizeof(*stats));
+	/* calloc() may return NULL for no element */
+	if ((!padding && image->num_sections) || (!stats && num_banks)) {
+		LOG_ERROR("Out of memory");
+		free(stats);
+		free(padding);
+		return ERROR_FAIL;
+	}
+
 	/* This fn requires all sections to be in ascending order of addresses,
 	 * whereas an image can have sections out of order. */
 	struct imagesection **sections = malloc(sizeof(struct imagesection *) *
@@ -764,6 +1176,16 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 	qsort(sections, image->num_sections, sizeof(struct imagesection *),
 		compare_section);
 
+	/* banks with a flash controller of their own are erased in the
+	 * background while the other banks are programmed */
+	if (erase && write && !differential && !flash_fingerprint_enabled() &&
+			flash_write_plan_erases(target, sections, image->num_sections,
+				stats, num_banks)) {
+		retval = flash_write_start_erases(target, stats, num_banks, unlock);
+		if (retval != ERROR_OK)
+			goto done;
+	}
+
 	/* loop until we reach end of the image */
 	while (section < image->num_sections) {
 		uint32_t buffer_idx;
@@ -950,22 +1372,60 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 		}
 
 		retval = ERROR_OK;
-
-		if (unlock)
-			retval = flash_unlock_address_range(target, run_address, run_size);
-		if (retval == ERROR_OK) {
-			if (erase) {
-				/* calculate and erase sectors */
-				retval = flash_erase_address_range(target,
-						true, run_address, run_size);
-			}
+		run_written = run_size;
+
+		struct flash_write_bank_stats *bank_stats = NULL;
+		if (c->bank_number < num_banks) {
+			bank_stats = &stats[c->bank_number];
+			/* the cache is only used to skip sectors */
+			if (!bank_stats->bytes && write && (erase || differential) &&
+					flash_fingerprint_enabled())
+				bank_stats->fingerprints = flash_fingerprint_check(c) == ERROR_OK;
+			bank_stats->bytes += run_size;
 		}
+		duration_start(&bench);
+
+		/* with valid fingerprints, the unchanged sectors need not be erased */
+		bool fingerprints = bank_stats && bank_stats->fingerprints && erase;
+
+		if ((differential || fingerprints) && write && c->num_sectors) {
+			/* erase and write the changed sectors only */
+			run_written = 0;
+			retval = flash_write_run_diff(target, c, buffer, run_address, run_size,
+					unlock, &run_written, &sectors_skipped, &sectors_written);
+			if (bank_stats)
+				bank_stats->program += flash_write_elapsed(&bench);
+		} else {
+			bool erased_ahead = bank_stats &&
+				bank_stats->erase_state >= FLASH_ERASE_AHEAD_RUNNING;
+
+			if (erased_ahead) {
+				/* unlocked and erased in the background, timed on its own */
+				retval = flash_write_poll_erases(stats, num_banks, c->bank_number, false);
+				flash_write_elapsed(&bench);
+			} else {
+				if (unlock)
+					retval = flash_unlock_address_range(target, run_address, run_size);
+				if (retval == ERROR_OK) {
+					if (erase) {
+						/* calculate and erase sectors */
+						retval = flash_erase_address_range(target,
+								true, run_address, run_size);
+					}
+				}
+				if (bank_stats)
+					bank_stats->erase += flash_write_elapsed(&bench);
+			}
 
-		if (retval == ERROR_OK) {
-			if (write) {
-				/* write flash sectors */
-				retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
+			if (retval == ERROR_OK) {
+				if (write) {
+					/* write flash sectors */
+					retval = flash_write_interleaved(c, buffer, run_address - c->base,
+							run_size, stats, num_banks);
+				}
 			}
+			if (bank_stats)
+				bank_stats->program += flash_write_elapsed(&bench);
 		}
 
 		if (retval == ERROR_OK) {
@@ -974,6 +1434,13 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 				retval = flash_driver_verify(c, buffer, run_address - c->base, run_size);
 			}
 		}
+		if (retval == ERROR_OK)
+			retval = flash_write_poll_erases(stats, num_banks, -1, false);
+		if (bank_stats)
+			bank_stats->verify += flash_write_elapsed(&bench);
+
+		if (retval == ERROR_OK && write)
+			flash_fingerprint_record(c, run_address - c->base, buffer, run_size, verify);
 
 		free(buffer);
 
@@ -983,10 +1450,32 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 		}
 
 		if (written)
-			*written += run_size;	/* add run size to total written counter */
+			*written += run_written;	/* add run size to total written counter */
+	}
+
+	if ((sectors_skipped || sectors_written) && retval == ERROR_OK)
+		LOG_INFO("%u flash sectors unchanged, %u sectors programmed",
+				sectors_skipped, sectors_written);
+
+	/* the checksum of the whole bank is taken once all its runs are written */
+	for (unsigned int i = 0; retval == ERROR_OK && write && i < num_banks; i++) {
+		if (!stats[i].bytes || !flash_fingerprint_enabled())
+			continue;
+
+		struct flash_bank *bank = get_flash_bank_by_num_noprobe(i);
+		if (bank && flash_fingerprint_save(bank) != ERROR_OK)
+			LOG_WARNING("flash fingerprints of %s not saved", bank->name);
 	}
 
 done:
+	/* leave no bank erasing, even on errors */
+	if (flash_write_poll_erases(stats, num_banks, -1, true) != ERROR_OK &&
+			retval == ERROR_OK)
+		retval = ERROR_FAIL;
+
+	flash_write_report_stats(stats, num_banks);
+
+	free(stats);
 	free(sections);
 	free(padding);
 
@@ -996,7 +1485,7 @@ done:
 int flash_write(struct target *target, struct image *image,
 	uint32_t *written, bool erase)
 {
-	return flash_write_unlock_verify(target, image, written, erase, false, true, false);
+	return flash_write_unlock_verify(target, image, written, erase, false, true, false, false);
 }
 
 struct flash_sector *alloc_block_array(uint32_t offset, uint32_t size,
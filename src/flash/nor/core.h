@@ -217,6 +217,12 @@ int default_flash_verify(struct flash_bank *bank,
  * @returns ERROR_OK if successful; otherwise, an error code.
  */
 int default_flash_blank_check(struct flash_bank *bank);
+/**
+ * Checks the erase state of all the sectors by reading them to the host,
+ * the slow fallback of default_flash_blank_check().
+ * @returns ERROR_OK if successful; otherwise, an error code.
+ */
+int default_flash_mem_blank_check(struct flash_bank *bank);
 /**
  * Returns the flash bank specified by @a name, which matches the
  * driver name and a suffix (option) specify the driver-specific
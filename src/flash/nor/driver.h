@@ -96,6 +96,31 @@ struct flash_driver {
 	int (*erase)(struct flash_bank *bank, unsigned int first,
 		unsigned int last);
 
+	/**
+	 * Optional split-phase erase, for banks with a flash controller of
+	 * their own. Starts erasing the sectors and returns without waiting,
+	 * so that other banks can be programmed meanwhile. The bank must not
+	 * be used until erase_poll() reports the end of the erase.
+	 *
+	 * @param bank The bank of flash to be erased.
+	 * @param first The number of the first sector to erase.
+	 * @param last The number of the last sector to erase.
+	 * @returns ERROR_OK if the erase was started; otherwise, an error code.
+	 */
+	int (*erase_start)(struct flash_bank *bank, unsigned int first,
+		unsigned int last);
+
+	/**
+	 * Check, without blocking, the erase started by erase_start(), moving
+	 * on to its next sector if needed.
+	 *
+	 * @param bank The bank of flash being erased.
+	 * @param done Set when all the sectors are erased.
+	 * @returns ERROR_OK if successful so far; otherwise, an error code,
+	 * the erase being then over.
+	 */
+	int (*erase_poll)(struct flash_bank *bank, bool *done);
+
 	/**
 	 * Bank/sector protection routine (target-specific).
 	 *
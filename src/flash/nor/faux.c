@@ -42,6 +42,7 @@ FLASH_BANK_COMMAND_HANDLER(faux_flash_bank_command)
 		LOG_ERROR("no memory for flash bank info");
 		return ERROR_FAIL;
 	}
+	memset(info->memory, 0xff, bank->size);
 	bank->driver_priv = info;
 
 	/* Use 0x10000 as a fixed sector size. */
@@ -81,6 +82,38 @@ static int faux_write(struct flash_bank *bank, const uint8_t *buffer, uint32_t o
 	return ERROR_OK;
 }
 
+/* the flash content is only in host memory, no target access is needed */
+static int faux_read(struct flash_bank *bank, uint8_t *buffer, uint32_t offset, uint32_t count)
+{
+	struct faux_flash_bank *info = bank->driver_priv;
+	memcpy(buffer, info->memory + offset, count);
+	return ERROR_OK;
+}
+
+static int faux_verify(struct flash_bank *bank, const uint8_t *buffer, uint32_t offset, uint32_t count)
+{
+	struct faux_flash_bank *info = bank->driver_priv;
+	return memcmp(info->memory + offset, buffer, count) ? ERROR_FAIL : ERROR_OK;
+}
+
+static int faux_erase_check(struct flash_bank *bank)
+{
+	struct faux_flash_bank *info = bank->driver_priv;
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		const uint8_t *data = info->memory + bank->sectors[i].offset;
+		bank->sectors[i].is_erased = 1;
+		for (uint32_t j = 0; j < bank->sectors[i].size; j++) {
+			if (data[j] != 0xff) {
+				bank->sectors[i].is_erased = 0;
+				break;
+			}
+		}
+	}
+
+	return ERROR_OK;
+}
+
 static int faux_info(struct flash_bank *bank, struct command_invocation *cmd)
 {
 	command_print_sameline(cmd, "faux flash driver");
@@ -109,10 +142,11 @@ const struct flash_driver faux_flash = {
 	.flash_bank_command = faux_flash_bank_command,
 	.erase = faux_erase,
 	.write = faux_write,
-	.read = default_flash_read,
+	.read = faux_read,
+	.verify = faux_verify,
 	.probe = faux_probe,
 	.auto_probe = faux_probe,
-	.erase_check = default_flash_blank_check,
+	.erase_check = faux_erase_check,
 	.info = faux_info,
 	.free_driver_priv = default_flash_free_driver_priv,
 };
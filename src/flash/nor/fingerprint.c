@@ -0,0 +1,428 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imp.h"
+#include <jtag/jtag.h>
+#include <target/image.h>
+
+/**
+ * @file
+ * Host side cache of the checksums of the flash sectors.
+ *
+ * The checksums of the sectors written by flash_write_unlock_verify() are
+ * kept in a file per flash bank, named after the IDCODE of the target and
+ * the name of the bank, together with the checksum of the whole bank as
+ * computed by the target. When the file is used again, possibly in another
+ * session, a single checksum of the bank on the target tells whether the
+ * flash still holds what was recorded. Only then the sector checksums are
+ * trusted, so the unchanged sectors are neither compared nor programmed.
+ */
+
+struct flash_fingerprints {
+	struct flash_bank *bank;
+	/* entries were read from the file */
+	bool loaded;
+	/* the known entries were checked against the flash */
+	bool valid;
+	/* checksum of the whole bank by the target, when saved */
+	bool bank_crc_valid;
+	uint32_t bank_crc;
+	/* per sector checksum, only valid when known */
+	bool *known;
+	uint32_t *crc;
+	struct flash_fingerprints *next;
+};
+
+static char *fingerprint_dir;
+static struct flash_fingerprints *fingerprints;
+
+bool flash_fingerprint_enabled(void)
+{
+	return fingerprint_dir;
+}
+
+const char *flash_fingerprint_dir(void)
+{
+	return fingerprint_dir;
+}
+
+static void fingerprint_free(struct flash_fingerprints *fp)
+{
+	free(fp->known);
+	free(fp->crc);
+	free(fp);
+}
+
+void flash_fingerprint_free_all(void)
+{
+	while (fingerprints) {
+		struct flash_fingerprints *next = fingerprints->next;
+		fingerprint_free(fingerprints);
+		fingerprints = next;
+	}
+}
+
+int flash_fingerprint_set_dir(const char *dir)
+{
+	char *copy = NULL;
+
+	if (dir) {
+		copy = strdup(dir);
+		if (!copy) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	free(fingerprint_dir);
+	fingerprint_dir = copy;
+
+	/* the entries belong to the files of the previous directory */
+	flash_fingerprint_free_all();
+
+	return ERROR_OK;
+}
+
+static char *fingerprint_file_name(struct flash_bank *bank)
+{
+	uint32_t idcode = bank->target->tap ? bank->target->tap->idcode : 0;
+
+	return alloc_printf("%s/%08" PRIx32 "-%s.fp", fingerprint_dir, idcode, bank->name);
+}
+
+static void fingerprint_forget_all(struct flash_fingerprints *fp)
+{
+	fp->valid = false;
+	fp->bank_crc_valid = false;
+	memset(fp->known, 0, fp->bank->num_sectors * sizeof(*fp->known));
+}
+
+static void fingerprint_load(struct flash_fingerprints *fp)
+{
+	struct flash_bank *bank = fp->bank;
+	char *name = fingerprint_file_name(bank);
+	if (!name)
+		return;
+
+	fp->loaded = true;
+	FILE *f = fopen(name, "r");
+	if (!f) {
+		LOG_DEBUG("no flash fingerprints in %s", name);
+		free(name);
+		return;
+	}
+
+	char line[128];
+	bool header = false;
+	while (fgets(line, sizeof(line), f)) {
+		unsigned long long base;
+		unsigned int sector, num_sectors;
+		uint32_t size, crc;
+
+		if (line[0] == '#')
+			continue;
+
+		if (sscanf(line, "bank 0x%llx 0x%" SCNx32 " %u", &base, &size, &num_sectors) == 3) {
+			header = base == bank->base && size == bank->size &&
+				num_sectors == bank->num_sectors;
+			if (!header)
+				break;
+		} else if (header && sscanf(line, "checksum 0x%" SCNx32, &crc) == 1) {
+			fp->bank_crc = crc;
+			fp->bank_crc_valid = true;
+		} else if (header && sscanf(line, "sector %u 0x%" SCNx32, &sector, &crc) == 2 &&
+				sector < bank->num_sectors) {
+			fp->crc[sector] = crc;
+			fp->known[sector] = true;
+		} else {
+			header = false;
+			break;
+		}
+	}
+	fclose(f);
+
+	if (!header || !fp->bank_crc_valid) {
+		LOG_WARNING("ignoring flash fingerprints in %s, not matching bank %s",
+				name, bank->name);
+		fingerprint_forget_all(fp);
+	}
+	free(name);
+}
+
+static struct flash_fingerprints *fingerprint_get(struct flash_bank *bank)
+{
+	if (!fingerprint_dir || !bank->num_sectors ||
+			bank->driver->read != default_flash_read)
+		return NULL;
+
+	struct flash_fingerprints *fp;
+	for (fp = fingerprints; fp; fp = fp->next) {
+		if (fp->bank == bank)
+			return fp;
+	}
+
+	fp = calloc(1, sizeof(*fp));
+	if (!fp) {
+		LOG_ERROR("Out of memory");
+		return NULL;
+	}
+	fp->bank = bank;
+	fp->known = calloc(bank->num_sectors, sizeof(*fp->known));
+	fp->crc = calloc(bank->num_sectors, sizeof(*fp->crc));
+	if (!fp->known || !fp->crc) {
+		LOG_ERROR("Out of memory");
+		fingerprint_free(fp);
+		return NULL;
+	}
+
+	fp->next = fingerprints;
+	fingerprints = fp;
+
+	return fp;
+}
+
+int flash_fingerprint_check(struct flash_bank *bank)
+{
+	struct flash_fingerprints *fp = fingerprint_get(bank);
+	if (!fp)
+		return ERROR_FAIL;
+
+	if (!fp->loaded)
+		fingerprint_load(fp);
+
+	/* the flash was changed since the fingerprints were saved */
+	if (!fp->bank_crc_valid) {
+		fingerprint_forget_all(fp);
+		return ERROR_FAIL;
+	}
+
+	/* the flash may have been changed by the target or by another tool */
+	uint32_t crc;
+	int retval = target_checksum_memory(bank->target, bank->base, bank->size, &crc);
+	if (retval != ERROR_OK || crc != fp->bank_crc) {
+		LOG_INFO("flash fingerprints of %s are out of date", bank->name);
+		fingerprint_forget_all(fp);
+		return ERROR_FAIL;
+	}
+
+	LOG_DEBUG("flash fingerprints of %s are valid", bank->name);
+	fp->valid = true;
+	return ERROR_OK;
+}
+
+int flash_fingerprint_lookup(struct flash_bank *bank, uint32_t offset,
+		const uint8_t *buffer, uint32_t size, bool *match)
+{
+	struct flash_fingerprints *fp = fingerprint_get(bank);
+	if (!fp || !fp->valid)
+		return ERROR_FAIL;
+
+	uint32_t end = offset + size;
+	bool all_match = true;
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		if (sector->offset + sector->size <= offset || sector->offset >= end)
+			continue;
+
+		/* only whole sectors have a checksum */
+		if (!fp->known[i] || sector->offset < offset ||
+				sector->offset + sector->size > end)
+			return ERROR_FAIL;
+
+		uint32_t crc;
+		int retval = image_calculate_checksum(buffer + (sector->offset - offset),
+				sector->size, &crc);
+		if (retval != ERROR_OK)
+			return retval;
+		if (crc != fp->crc[i])
+			all_match = false;
+	}
+
+	*match = all_match;
+	return ERROR_OK;
+}
+
+void flash_fingerprint_forget(struct flash_bank *bank, uint32_t offset, uint32_t size)
+{
+	struct flash_fingerprints *fp = fingerprint_get(bank);
+	if (!fp)
+		return;
+
+	/* the saved checksum of the bank does not match any more */
+	fp->bank_crc_valid = false;
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		if (sector->offset < offset + size && sector->offset + sector->size > offset)
+			fp->known[i] = false;
+	}
+}
+
+void flash_fingerprint_record(struct flash_bank *bank, uint32_t offset,
+		const uint8_t *buffer, uint32_t size, bool verified)
+{
+	struct flash_fingerprints *fp = fingerprint_get(bank);
+	if (!fp)
+		return;
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		if (sector->offset < offset || sector->offset + sector->size > offset + size)
+			continue;
+
+		uint32_t crc;
+		if (image_calculate_checksum(buffer + (sector->offset - offset),
+				sector->size, &crc) != ERROR_OK) {
+			fp->known[i] = false;
+			continue;
+		}
+
+		/* left unchanged, as the cache already knew */
+		if (fp->known[i] && fp->crc[i] == crc)
+			continue;
+
+		/* the sector must hold the data before its checksum is trusted */
+		if (!verified) {
+			uint32_t target_crc;
+			int retval = target_checksum_memory(bank->target,
+					bank->base + sector->offset, sector->size, &target_crc);
+			if (retval != ERROR_OK || target_crc != crc) {
+				if (retval == ERROR_OK)
+					LOG_WARNING("flash sector %u of %s does not hold the written data",
+							i, bank->name);
+				fp->known[i] = false;
+				continue;
+			}
+		}
+
+		fp->crc[i] = crc;
+		fp->known[i] = true;
+	}
+}
+
+static int fingerprint_erased_crc(struct flash_bank *bank, uint32_t size, uint32_t *crc)
+{
+	uint8_t *erased = malloc(size);
+	if (!erased) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	memset(erased, bank->erased_value, size);
+	int retval = image_calculate_checksum(erased, size, crc);
+	free(erased);
+
+	return retval;
+}
+
+void flash_fingerprint_erased(struct flash_bank *bank, unsigned int first,
+		unsigned int last)
+{
+	struct flash_fingerprints *fp = fingerprint_get(bank);
+	if (!fp)
+		return;
+
+	fp->bank_crc_valid = false;
+
+	/* sectors are mostly of the same size */
+	uint32_t erased_size = 0;
+	uint32_t erased_crc;
+
+	for (unsigned int i = first; i <= last && i < bank->num_sectors; i++) {
+		uint32_t size = bank->sectors[i].size;
+
+		fp->known[i] = false;
+		if (size != erased_size) {
+			if (fingerprint_erased_crc(bank, size, &erased_crc) != ERROR_OK) {
+				erased_size = 0;
+				continue;
+			}
+			erased_size = size;
+		}
+
+		/* as for the written sectors, the target must confirm the erase */
+		uint32_t target_crc;
+		if (target_checksum_memory(bank->target, bank->base + bank->sectors[i].offset,
+				size, &target_crc) != ERROR_OK || target_crc != erased_crc)
+			continue;
+
+		fp->crc[i] = erased_crc;
+		fp->known[i] = true;
+	}
+}
+
+int flash_fingerprint_save(struct flash_bank *bank)
+{
+	struct flash_fingerprints *fp = fingerprint_get(bank);
+	if (!fp)
+		return ERROR_OK;
+
+	int retval = target_checksum_memory(bank->target, bank->base, bank->size, &fp->bank_crc);
+	if (retval != ERROR_OK)
+		return retval;
+	fp->bank_crc_valid = true;
+
+	char *name = fingerprint_file_name(bank);
+	if (!name)
+		return ERROR_FAIL;
+
+	FILE *f = fopen(name, "w");
+	if (!f) {
+		LOG_ERROR("can't write flash fingerprints to %s", name);
+		free(name);
+		return ERROR_FAIL;
+	}
+
+	fprintf(f, "# OpenOCD flash fingerprints of %s\n", bank->name);
+	fprintf(f, "bank 0x%llx 0x%" PRIx32 " %u\n", (unsigned long long)bank->base,
+			bank->size, bank->num_sectors);
+	fprintf(f, "checksum 0x%08" PRIx32 "\n", fp->bank_crc);
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		if (fp->known[i])
+			fprintf(f, "sector %u 0x%08" PRIx32 "\n", i, fp->crc[i]);
+	}
+
+	if (fclose(f)) {
+		LOG_ERROR("error writing flash fingerprints to %s", name);
+		retval = ERROR_FAIL;
+	}
+	free(name);
+
+	return retval;
+}
+
+int flash_fingerprint_erase_check(struct flash_bank *bank)
+{
+	int retval = flash_fingerprint_check(bank);
+	if (retval != ERROR_OK)
+		return retval;
+
+	struct flash_fingerprints *fp = fingerprint_get(bank);
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		if (!fp->known[i])
+			return ERROR_FAIL;
+	}
+
+	/* the erased sectors are found by their checksum */
+	uint32_t erased_size = 0;
+	uint32_t erased_crc;
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		uint32_t size = bank->sectors[i].size;
+
+		if (size != erased_size) {
+			retval = fingerprint_erased_crc(bank, size, &erased_crc);
+			if (retval != ERROR_OK)
+				return retval;
+			erased_size = size;
+		}
+
+		bank->sectors[i].is_erased = fp->crc[i] == erased_crc;
+	}
+
+	return ERROR_OK;
+}
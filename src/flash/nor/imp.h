@@ -37,8 +37,32 @@ int flash_driver_read(struct flash_bank *bank,
 int flash_driver_verify(struct flash_bank *bank,
 		const uint8_t *buffer, uint32_t offset, uint32_t count);
 
-/* write (optional verify) an image to flash memory of the given target */
+/* write (optional verify) an image to flash memory of the given target,
+ * if differential only the sectors that differ from the image are erased and written */
 int flash_write_unlock_verify(struct target *target, struct image *image,
-		uint32_t *written, bool erase, bool unlock, bool write, bool verify);
+		uint32_t *written, bool erase, bool unlock, bool write, bool verify, bool differential);
+
+/* host side cache of the sector checksums, see fingerprint.c */
+bool flash_fingerprint_enabled(void);
+const char *flash_fingerprint_dir(void);
+/* @a dir NULL disables the cache */
+int flash_fingerprint_set_dir(const char *dir);
+void flash_fingerprint_free_all(void);
+/* check the whole bank on the target before the cache is used */
+int flash_fingerprint_check(struct flash_bank *bank);
+/* @returns ERROR_OK if the cache knows whether the whole sectors of a
+ * range hold @a buffer, setting @a match */
+int flash_fingerprint_lookup(struct flash_bank *bank, uint32_t offset,
+		const uint8_t *buffer, uint32_t size, bool *match);
+void flash_fingerprint_forget(struct flash_bank *bank, uint32_t offset, uint32_t size);
+/* record the sectors holding @a buffer, checksummed on the target
+ * unless the write was @a verified */
+void flash_fingerprint_record(struct flash_bank *bank, uint32_t offset,
+		const uint8_t *buffer, uint32_t size, bool verified);
+void flash_fingerprint_erased(struct flash_bank *bank, unsigned int first,
+		unsigned int last);
+int flash_fingerprint_save(struct flash_bank *bank);
+/* set the erase state of the sectors from the cache */
+int flash_fingerprint_erase_check(struct flash_bank *bank);
 
 #endif /* OPENOCD_FLASH_NOR_IMP_H */
@@ -572,11 +572,8 @@ static int lpcspifi_write(struct flash_bank *bank, const uint8_t *buffer,
 {
 	struct target *target = bank->target;
 	struct lpcspifi_flash_bank *lpcspifi_info = bank->driver_priv;
-	uint32_t page_size, fifo_size;
-	struct working_area *fifo;
-	struct reg_param reg_params[5];
+	uint32_t page_size;
 	struct armv7m_algorithm armv7m_info;
-	struct working_area *write_algorithm;
 	int retval = ERROR_OK;
 
 	LOG_DEBUG("offset=0x%08" PRIx32 " count=0x%08" PRIx32,
@@ -634,122 +631,76 @@ static int lpcspifi_write(struct flash_bank *bank, const uint8_t *buffer,
 		0xc4, 0xf2, 0x08, 0x0a, 0x4f, 0xf0, 0x07, 0x08,
 		0xca, 0xf8, 0x00, 0x80, 0x4f, 0xf0, 0x02, 0x08,
 		0xca, 0xf8, 0x10, 0x80, 0xca, 0xf8, 0x04, 0x80,
-		0x4f, 0xf0, 0x00, 0x0b, 0xa3, 0x44, 0x93, 0x45,
-		0x7f, 0xf6, 0xfc, 0xaf, 0x00, 0xf0, 0x6a, 0xf8,
-		0x4f, 0xf0, 0x06, 0x09, 0x00, 0xf0, 0x53, 0xf8,
-		0x00, 0xf0, 0x60, 0xf8, 0x00, 0xf0, 0x62, 0xf8,
-		0x4f, 0xf0, 0x05, 0x09, 0x00, 0xf0, 0x4b, 0xf8,
-		0x4f, 0xf0, 0x00, 0x09, 0x00, 0xf0, 0x47, 0xf8,
-		0x00, 0xf0, 0x54, 0xf8, 0x19, 0xf0, 0x02, 0x0f,
-		0x00, 0xf0, 0x5d, 0x80, 0x00, 0xf0, 0x52, 0xf8,
-		0x4f, 0xf0, 0x02, 0x09, 0x00, 0xf0, 0x3b, 0xf8,
-		0x4f, 0xea, 0x12, 0x49, 0x00, 0xf0, 0x37, 0xf8,
-		0x4f, 0xea, 0x12, 0x29, 0x00, 0xf0, 0x33, 0xf8,
-		0x4f, 0xea, 0x02, 0x09, 0x00, 0xf0, 0x2f, 0xf8,
-		0xd0, 0xf8, 0x00, 0x80, 0xb8, 0xf1, 0x00, 0x0f,
-		0x00, 0xf0, 0x47, 0x80, 0x47, 0x68, 0x47, 0x45,
-		0x3f, 0xf4, 0xf6, 0xaf, 0x17, 0xf8, 0x01, 0x9b,
-		0x00, 0xf0, 0x21, 0xf8, 0x8f, 0x42, 0x28, 0xbf,
-		0x00, 0xf1, 0x08, 0x07, 0x47, 0x60, 0x01, 0x3b,
-		0xbb, 0xb3, 0x02, 0xf1, 0x01, 0x02, 0x93, 0x45,
-		0x7f, 0xf4, 0xe6, 0xaf, 0x00, 0xf0, 0x22, 0xf8,
-		0xa3, 0x44, 0x00, 0xf0, 0x23, 0xf8, 0x4f, 0xf0,
-		0x05, 0x09, 0x00, 0xf0, 0x0c, 0xf8, 0x4f, 0xf0,
-		0x00, 0x09, 0x00, 0xf0, 0x08, 0xf8, 0x00, 0xf0,
-		0x15, 0xf8, 0x19, 0xf0, 0x01, 0x0f, 0x7f, 0xf4,
-		0xf0, 0xaf, 0xff, 0xf7, 0xa7, 0xbf, 0x4f, 0xf4,
-		0x40, 0x5a, 0xc4, 0xf2, 0x08, 0x0a, 0xca, 0xf8,
-		0x08, 0x90, 0xda, 0xf8, 0x0c, 0x90, 0x19, 0xf0,
-		0x10, 0x0f, 0x7f, 0xf4, 0xfa, 0xaf, 0xda, 0xf8,
+		0x6f, 0xf0, 0x00, 0x05, 0x41, 0xf6, 0xb7, 0x56,
+		0xc0, 0xf2, 0xc1, 0x46, 0x94, 0x46, 0x4f, 0xf0,
+		0x00, 0x0b, 0xa3, 0x44, 0x93, 0x45, 0xfc, 0xd9,
+		0x00, 0xf0, 0x9b, 0xf8, 0x4f, 0xf0, 0x06, 0x09,
+		0x00, 0xf0, 0x86, 0xf8, 0x00, 0xf0, 0x92, 0xf8,
+		0x00, 0xf0, 0x93, 0xf8, 0x4f, 0xf0, 0x05, 0x09,
+		0x00, 0xf0, 0x7e, 0xf8, 0x4f, 0xf0, 0x00, 0x09,
+		0x00, 0xf0, 0x7a, 0xf8, 0x00, 0xf0, 0x86, 0xf8,
+		0x19, 0xf0, 0x02, 0x0f, 0x00, 0xf0, 0x8e, 0x80,
+		0x00, 0xf0, 0x83, 0xf8, 0x4f, 0xf0, 0x02, 0x09,
+		0x00, 0xf0, 0x6e, 0xf8, 0x4f, 0xea, 0x12, 0x49,
+		0x00, 0xf0, 0x6a, 0xf8, 0x4f, 0xea, 0x12, 0x29,
+		0x00, 0xf0, 0x66, 0xf8, 0x4f, 0xea, 0x02, 0x09,
+		0x00, 0xf0, 0x62, 0xf8, 0xd0, 0xf8, 0x00, 0x80,
+		0xb8, 0xf1, 0x00, 0x0f, 0x7a, 0xd0, 0x47, 0x68,
+		0x47, 0x45, 0xf7, 0xd0, 0x17, 0xf8, 0x01, 0x9b,
+		0x00, 0xf0, 0x56, 0xf8, 0x8f, 0x42, 0x28, 0xbf,
+		0x00, 0xf1, 0x08, 0x07, 0x47, 0x60, 0x02, 0xf1,
+		0x01, 0x02, 0x5b, 0x1e, 0x01, 0xd0, 0x93, 0x45,
+		0xe8, 0xd1, 0x00, 0xf0, 0x57, 0xf8, 0x00, 0xf0,
+		0x58, 0xf8, 0x4f, 0xf0, 0x05, 0x09, 0x00, 0xf0,
+		0x43, 0xf8, 0x4f, 0xf0, 0x00, 0x09, 0x00, 0xf0,
+		0x3f, 0xf8, 0x00, 0xf0, 0x4b, 0xf8, 0x19, 0xf0,
+		0x01, 0x0f, 0xf0, 0xd1, 0x00, 0xf0, 0x49, 0xf8,
+		0x4f, 0xf0, 0x03, 0x09, 0x00, 0xf0, 0x34, 0xf8,
+		0x4f, 0xea, 0x1c, 0x49, 0x00, 0xf0, 0x30, 0xf8,
+		0x4f, 0xea, 0x1c, 0x29, 0x00, 0xf0, 0x2c, 0xf8,
+		0x4f, 0xea, 0x0c, 0x09, 0x00, 0xf0, 0x28, 0xf8,
+		0x4f, 0xf0, 0x00, 0x09, 0x00, 0xf0, 0x24, 0xf8,
+		0x85, 0xea, 0x09, 0x65, 0x6d, 0x00, 0x28, 0xbf,
+		0x75, 0x40, 0x6d, 0x00, 0x28, 0xbf, 0x75, 0x40,
+		0x6d, 0x00, 0x28, 0xbf, 0x75, 0x40, 0x6d, 0x00,
+		0x28, 0xbf, 0x75, 0x40, 0x6d, 0x00, 0x28, 0xbf,
+		0x75, 0x40, 0x6d, 0x00, 0x28, 0xbf, 0x75, 0x40,
+		0x6d, 0x00, 0x28, 0xbf, 0x75, 0x40, 0x6d, 0x00,
+		0x28, 0xbf, 0x75, 0x40, 0x0c, 0xf1, 0x01, 0x0c,
+		0x94, 0x45, 0xdd, 0xd1, 0x00, 0xf0, 0x12, 0xf8,
+		0x00, 0x2b, 0x1f, 0xd0, 0xa3, 0x44, 0x73, 0xe7,
+		0x4f, 0xf4, 0x40, 0x5a, 0xc4, 0xf2, 0x08, 0x0a,
+		0xca, 0xf8, 0x08, 0x90, 0xda, 0xf8, 0x0c, 0x90,
+		0x19, 0xf0, 0x10, 0x0f, 0xfa, 0xd1, 0xda, 0xf8,
 		0x08, 0x90, 0x70, 0x47, 0x4f, 0xf0, 0xff, 0x08,
-		0x00, 0xf0, 0x02, 0xb8, 0x4f, 0xf0, 0x00, 0x08,
-		0x4f, 0xf4, 0x80, 0x4a, 0xc4, 0xf2, 0x0f, 0x0a,
-		0xca, 0xf8, 0xab, 0x80, 0x70, 0x47, 0x00, 0x20,
-		0x50, 0x60, 0xff, 0xf7, 0xef, 0xff, 0x30, 0x46,
-		0x00, 0xbe, 0xff, 0xff
+		0x01, 0xe0, 0x4f, 0xf0, 0x00, 0x08, 0x4f, 0xf4,
+		0x80, 0x4a, 0xc4, 0xf2, 0x0f, 0x0a, 0xca, 0xf8,
+		0xab, 0x80, 0x70, 0x47, 0x4f, 0xf0, 0x00, 0x08,
+		0xc0, 0xf8, 0x04, 0x80, 0xff, 0xf7, 0xee, 0xff,
+		0x00, 0xbe
 	};
 
-	if (target_alloc_working_area(target, sizeof(lpcspifi_flash_write_code),
-			&write_algorithm) != ERROR_OK) {
-		LOG_ERROR("Insufficient working area. You must configure"
-			" a working area > %zdB in order to write to SPIFI flash.",
-			sizeof(lpcspifi_flash_write_code));
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	}
-
-	retval = target_write_buffer(target, write_algorithm->address,
-			sizeof(lpcspifi_flash_write_code),
-			lpcspifi_flash_write_code);
-	if (retval != ERROR_OK) {
-		target_free_working_area(target, write_algorithm);
-		return retval;
-	}
-
-	/* FIFO allocation */
-	fifo_size = target_get_working_area_avail(target);
-
-	if (fifo_size == 0) {
-		/* if we already allocated the writing code but failed to get fifo
-		 * space, free the algorithm */
-		target_free_working_area(target, write_algorithm);
-
-		LOG_ERROR("Insufficient working area. Please allocate at least"
-			" %zdB of working area to enable flash writes.",
-			sizeof(lpcspifi_flash_write_code) + 1
-		);
-
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	} else if (fifo_size < page_size)
-		LOG_WARNING("Working area size is limited; flash writes may be"
-			" slow. Increase working area size to at least %zdB"
-			" to reduce write times.",
-			(size_t)(sizeof(lpcspifi_flash_write_code) + page_size)
-		);
-	else if (fifo_size > 0x2000) /* Beyond this point, we start to get diminishing returns */
-		fifo_size = 0x2000;
-
-	if (target_alloc_working_area(target, fifo_size, &fifo) != ERROR_OK) {
-		target_free_working_area(target, write_algorithm);
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	}
-
 	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
 	armv7m_info.core_mode = ARM_MODE_THREAD;
 
-	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);		/* buffer start, status (out) */
-	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);		/* buffer end */
-	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);		/* target address */
-	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);		/* count (halfword-16bit) */
-	init_reg_param(&reg_params[4], "r4", 32, PARAM_OUT);		/* page size */
-
-	buf_set_u32(reg_params[0].value, 0, 32, fifo->address);
-	buf_set_u32(reg_params[1].value, 0, 32, fifo->address + fifo->size);
-	buf_set_u32(reg_params[2].value, 0, 32, offset);
-	buf_set_u32(reg_params[3].value, 0, 32, count);
-	buf_set_u32(reg_params[4].value, 0, 32, page_size);
-
-	retval = target_run_flash_async_algorithm(target, buffer, count, 1,
-			0, NULL,
-			5, reg_params,
-			fifo->address, fifo->size,
-			write_algorithm->address, 0,
-			&armv7m_info
-	);
-
-	if (retval != ERROR_OK)
-		LOG_ERROR("Error executing flash write algorithm");
+	/* buffer start, buffer end, target address, count, page size */
+	static const char * const reg_names[] = { "r0", "r1", "r2", "r3", "r4" };
 
-	target_free_working_area(target, fifo);
-	target_free_working_area(target, write_algorithm);
+	const struct spi_flash_loader loader = {
+		.code = lpcspifi_flash_write_code,
+		.code_size = sizeof(lpcspifi_flash_write_code),
+		.max_fifo_size = 0x2000,
+		.reg_names = reg_names,
+		.crc_reg_name = "r5",
+		.arch_info = &armv7m_info,
+	};
 
-	destroy_reg_param(&reg_params[0]);
-	destroy_reg_param(&reg_params[1]);
-	destroy_reg_param(&reg_params[2]);
-	destroy_reg_param(&reg_params[3]);
-	destroy_reg_param(&reg_params[4]);
+	retval = spi_flash_async_write(bank, &loader, buffer, offset, count, page_size);
 
 	/* Switch to HW mode before return to prompt */
-	retval = lpcspifi_set_hw_mode(bank);
+	int retval2 = lpcspifi_set_hw_mode(bank);
+	if (retval == ERROR_OK)
+		retval = retval2;
 	return retval;
 }
 
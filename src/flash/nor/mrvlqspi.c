@@ -581,11 +581,8 @@ static int mrvlqspi_flash_write(struct flash_bank *bank, const uint8_t *buffer,
 	struct target *target = bank->target;
 	struct mrvlqspi_flash_bank *mrvlqspi_info = bank->driver_priv;
 	int retval = ERROR_OK;
-	uint32_t page_size, fifo_size;
-	struct working_area *fifo;
-	struct reg_param reg_params[6];
+	uint32_t page_size;
 	struct armv7m_algorithm armv7m_info;
-	struct working_area *write_algorithm;
 
 	LOG_DEBUG("offset=0x%08" PRIx32 " count=0x%08" PRIx32,
 		offset, count);
@@ -667,85 +664,23 @@ static int mrvlqspi_flash_write(struct flash_bank *bank, const uint8_t *buffer,
 		0x00, 0x20, 0x50, 0x60, 0x30, 0x46, 0x00, 0xbe
 	};
 
-	if (target_alloc_working_area(target, sizeof(mrvlqspi_flash_write_code),
-			&write_algorithm) != ERROR_OK) {
-		LOG_ERROR("Insufficient working area. You must configure"
-			" a working area > %zdB in order to write to SPIFI flash.",
-			sizeof(mrvlqspi_flash_write_code));
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	}
-
-	retval = target_write_buffer(target, write_algorithm->address,
-			sizeof(mrvlqspi_flash_write_code),
-			mrvlqspi_flash_write_code);
-	if (retval != ERROR_OK) {
-		target_free_working_area(target, write_algorithm);
-		return retval;
-	}
-
-	/* FIFO allocation */
-	fifo_size = target_get_working_area_avail(target);
-
-	if (fifo_size == 0) {
-		/* if we already allocated the writing code but failed to get fifo
-		 * space, free the algorithm */
-		target_free_working_area(target, write_algorithm);
-
-		LOG_ERROR("Insufficient working area. Please allocate at least"
-			" %zdB of working area to enable flash writes.",
-			sizeof(mrvlqspi_flash_write_code) + 1
-		);
-
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	} else if (fifo_size < page_size)
-		LOG_WARNING("Working area size is limited; flash writes may be"
-			" slow. Increase working area size to at least %zdB"
-			" to reduce write times.",
-			(size_t)(sizeof(mrvlqspi_flash_write_code) + page_size)
-		);
-
-	if (target_alloc_working_area(target, fifo_size, &fifo) != ERROR_OK) {
-		target_free_working_area(target, write_algorithm);
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	}
-
 	armv7m_info.common_magic = ARMV7M_COMMON_MAGIC;
 	armv7m_info.core_mode = ARM_MODE_THREAD;
 
-	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);	/* buffer start, status (out) */
-	init_reg_param(&reg_params[1], "r1", 32, PARAM_OUT);	/* buffer end */
-	init_reg_param(&reg_params[2], "r2", 32, PARAM_OUT);	/* target address */
-	init_reg_param(&reg_params[3], "r3", 32, PARAM_OUT);	/* count (halfword-16bit) */
-	init_reg_param(&reg_params[4], "r4", 32, PARAM_OUT);	/* page size */
-	init_reg_param(&reg_params[5], "r5", 32, PARAM_OUT);	/* qspi base address */
-
-	buf_set_u32(reg_params[0].value, 0, 32, fifo->address);
-	buf_set_u32(reg_params[1].value, 0, 32, fifo->address + fifo->size);
-	buf_set_u32(reg_params[2].value, 0, 32, offset);
-	buf_set_u32(reg_params[3].value, 0, 32, count);
-	buf_set_u32(reg_params[4].value, 0, 32, page_size);
-	buf_set_u32(reg_params[5].value, 0, 32, (uint32_t) mrvlqspi_info->reg_base);
-
-	retval = target_run_flash_async_algorithm(target, buffer, count, 1,
-			0, NULL,
-			6, reg_params,
-			fifo->address, fifo->size,
-			write_algorithm->address, 0,
-			&armv7m_info
-	);
-
-	if (retval != ERROR_OK)
-		LOG_ERROR("Error executing flash write algorithm");
-
-	target_free_working_area(target, fifo);
-	target_free_working_area(target, write_algorithm);
-
-	destroy_reg_param(&reg_params[0]);
-	destroy_reg_param(&reg_params[1]);
-	destroy_reg_param(&reg_params[2]);
-	destroy_reg_param(&reg_params[3]);
-	destroy_reg_param(&reg_params[4]);
-	destroy_reg_param(&reg_params[5]);
+	/* buffer start, buffer end, target address, count, page size, qspi base address */
+	static const char * const reg_names[] = { "r0", "r1", "r2", "r3", "r4", "r5" };
+	const uint32_t extra_values[] = { (uint32_t)mrvlqspi_info->reg_base };
+
+	const struct spi_flash_loader loader = {
+		.code = mrvlqspi_flash_write_code,
+		.code_size = sizeof(mrvlqspi_flash_write_code),
+		.reg_names = reg_names,
+		.extra_values = extra_values,
+		.num_extra = ARRAY_SIZE(extra_values),
+		.arch_info = &armv7m_info,
+	};
+
+	retval = spi_flash_async_write(bank, &loader, buffer, offset, count, page_size);
 
 	return retval;
 }
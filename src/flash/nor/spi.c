@@ -18,6 +18,8 @@
 #include "imp.h"
 #include "spi.h"
 #include <jtag/jtag.h>
+#include <target/algorithm.h>
+#include <target/image.h>
 
  /* Shared table of known SPI flash devices for SPI-based flash drivers. Taken
   * from device datasheets and Linux SPI flash drivers. */
@@ -208,3 +210,112 @@ const struct flash_device flash_devices[] = {
 
 	FLASH_ID(NULL,                  0,    0,    0,    0,    0,    0,          0,     0,       0)
 };
+
+/* Write count bytes at offset with the loader. The code is loaded at the start
+ * of the working area and the rest of it is used as fifo, so the transfer of
+ * the data overlaps with the programming of the previous pages. */
+int spi_flash_async_write(struct flash_bank *bank, const struct spi_flash_loader *loader,
+	const uint8_t *buffer, uint32_t offset, uint32_t count, uint32_t page_size)
+{
+	struct target *target = bank->target;
+	struct working_area *write_algorithm;
+	struct working_area *fifo;
+	struct reg_param reg_params[SPI_LOADER_MAX_REGS];
+	unsigned int num_regs = 5 + loader->num_extra;
+	unsigned int crc_reg = num_regs;
+	uint32_t fifo_size;
+	int retval;
+
+	if (loader->crc_reg_name)
+		num_regs++;
+	assert(num_regs <= SPI_LOADER_MAX_REGS);
+
+	if (target_alloc_working_area(target, loader->code_size,
+			&write_algorithm) != ERROR_OK) {
+		LOG_ERROR("Insufficient working area. You must configure"
+			" a working area > %" PRIu32 "B in order to write to SPI flash.",
+			loader->code_size);
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	retval = target_write_buffer(target, write_algorithm->address,
+			loader->code_size, loader->code);
+	if (retval != ERROR_OK) {
+		target_free_working_area(target, write_algorithm);
+		return retval;
+	}
+
+	/* FIFO allocation */
+	fifo_size = target_get_working_area_avail(target);
+
+	if (fifo_size == 0) {
+		/* if we already allocated the writing code but failed to get fifo
+		 * space, free the algorithm */
+		target_free_working_area(target, write_algorithm);
+
+		LOG_ERROR("Insufficient working area. Please allocate at least"
+			" %" PRIu32 "B of working area to enable flash writes.",
+			loader->code_size + 1);
+
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	} else if (fifo_size < page_size) {
+		LOG_WARNING("Working area size is limited; flash writes may be"
+			" slow. Increase working area size to at least %" PRIu32 "B"
+			" to reduce write times.",
+			loader->code_size + page_size);
+	} else if (loader->max_fifo_size && fifo_size > loader->max_fifo_size) {
+		fifo_size = loader->max_fifo_size;
+	}
+
+	if (target_alloc_working_area(target, fifo_size, &fifo) != ERROR_OK) {
+		target_free_working_area(target, write_algorithm);
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	/* buffer start, status (out) */
+	init_reg_param(&reg_params[0], loader->reg_names[0], 32, PARAM_IN_OUT);
+	for (unsigned int i = 1; i < crc_reg; i++)
+		init_reg_param(&reg_params[i], loader->reg_names[i], 32, PARAM_OUT);
+	if (loader->crc_reg_name)
+		init_reg_param(&reg_params[crc_reg], loader->crc_reg_name, 32, PARAM_IN);
+
+	buf_set_u32(reg_params[0].value, 0, 32, fifo->address);
+	buf_set_u32(reg_params[1].value, 0, 32, fifo->address + fifo->size);
+	buf_set_u32(reg_params[2].value, 0, 32, offset);
+	buf_set_u32(reg_params[3].value, 0, 32, count);
+	buf_set_u32(reg_params[4].value, 0, 32, page_size);
+	for (unsigned int i = 0; i < loader->num_extra; i++)
+		buf_set_u32(reg_params[5 + i].value, 0, 32, loader->extra_values[i]);
+
+	retval = target_run_flash_async_algorithm(target, buffer, count, 1,
+			0, NULL,
+			num_regs, reg_params,
+			fifo->address, fifo->size,
+			write_algorithm->address, 0,
+			loader->arch_info);
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error executing flash write algorithm");
+	} else if (loader->crc_reg_name) {
+		/* the loader read every page back, no need to read the flash
+		 * through the debugger to find out whether the write failed */
+		uint32_t target_crc = buf_get_u32(reg_params[crc_reg].value, 0, 32);
+		uint32_t crc;
+
+		retval = image_calculate_checksum(buffer, count, &crc);
+		if (retval == ERROR_OK && crc != target_crc) {
+			LOG_ERROR("SPI flash write failed at offset 0x%8.8" PRIx32
+				", checksum 0x%8.8" PRIx32 " read back instead of 0x%8.8" PRIx32,
+				offset, target_crc, crc);
+			retval = ERROR_FLASH_OPERATION_FAILED;
+		}
+	}
+
+	target_free_working_area(target, fifo);
+	target_free_working_area(target, write_algorithm);
+
+	for (unsigned int i = 0; i < num_regs; i++)
+		destroy_reg_param(&reg_params[i]);
+
+	return retval;
+}
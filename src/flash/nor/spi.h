@@ -60,6 +60,34 @@ struct flash_device {
 
 extern const struct flash_device flash_devices[];
 
+/* maximum number of registers passed to a SPI flash write loader */
+#define SPI_LOADER_MAX_REGS		8
+
+/* SPI flash write algorithm run by spi_flash_async_write(), see
+ * target_run_flash_async_algorithm() for the protocol of the fifo.
+ * The 32 bit registers named in reg_names get:
+ * [0] fifo start (status on exit), [1] fifo end, [2] flash offset,
+ * [3] byte count, [4] page size, then the num_extra values of extra_values. */
+struct spi_flash_loader {
+	const uint8_t *code;
+	uint32_t code_size;
+	/* the fifo is limited to this size, 0 for no limit */
+	uint32_t max_fifo_size;
+	const char * const *reg_names;
+	const uint32_t *extra_values;
+	unsigned int num_extra;
+	/* register in which the loader returns the CRC of the data it read back
+	 * from the flash after programming it, computed like
+	 * image_calculate_checksum(); NULL if the loader does not check */
+	const char *crc_reg_name;
+	void *arch_info;
+};
+
+struct flash_bank;
+
+int spi_flash_async_write(struct flash_bank *bank, const struct spi_flash_loader *loader,
+	const uint8_t *buffer, uint32_t offset, uint32_t count, uint32_t page_size);
+
 #endif
 
 /* fields in SPI flash status register */
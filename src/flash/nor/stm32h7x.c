@@ -9,6 +9,7 @@
 
 #include "imp.h"
 #include <helper/binarybuffer.h>
+#include <helper/time_support.h>
 #include <target/algorithm.h>
 #include <target/cortex_m.h>
 
@@ -125,6 +126,11 @@ struct stm32h7x_flash_bank {
 	uint32_t user_bank_size;
 	uint32_t flash_regs_base;    /* Address of flash reg controller */
 	const struct stm32h7x_part_info *part_info;
+	/* split-phase erase, see stm32x_erase_start() */
+	bool erasing;
+	unsigned int erase_sector;
+	unsigned int erase_last;
+	int64_t erase_deadline;
 };
 
 enum stm32h7x_opt_rdp {
@@ -460,10 +466,27 @@ static int stm32x_protect_check(struct flash_bank *bank)
 	return ERROR_OK;
 }
 
+/* set the SER bit and select the sector, then set the STRT bit */
+static int stm32x_erase_sector_start(struct flash_bank *bank, unsigned int sector)
+{
+	struct stm32h7x_flash_bank *stm32x_info = bank->driver_priv;
+
+	LOG_DEBUG("erase sector %u", sector);
+	int retval = stm32x_write_flash_reg(bank, FLASH_CR,
+			stm32x_info->part_info->compute_flash_cr(FLASH_SER | FLASH_PSIZE_64, sector));
+	if (retval == ERROR_OK)
+		retval = stm32x_write_flash_reg(bank, FLASH_CR,
+				stm32x_info->part_info->compute_flash_cr(FLASH_SER | FLASH_PSIZE_64 | FLASH_START,
+					sector));
+	if (retval != ERROR_OK)
+		LOG_ERROR("Error erase sector %u", sector);
+
+	return retval;
+}
+
 static int stm32x_erase(struct flash_bank *bank, unsigned int first,
 		unsigned int last)
 {
-	struct stm32h7x_flash_bank *stm32x_info = bank->driver_priv;
 	int retval, retval2;
 
 	assert(first < bank->num_sectors);
@@ -487,19 +510,9 @@ static int stm32x_erase(struct flash_bank *bank, unsigned int first,
 	4. Wait for flash operations completion
 	 */
 	for (unsigned int i = first; i <= last; i++) {
-		LOG_DEBUG("erase sector %u", i);
-		retval = stm32x_write_flash_reg(bank, FLASH_CR,
-				stm32x_info->part_info->compute_flash_cr(FLASH_SER | FLASH_PSIZE_64, i));
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error erase sector %u", i);
-			goto flash_lock;
-		}
-		retval = stm32x_write_flash_reg(bank, FLASH_CR,
-				stm32x_info->part_info->compute_flash_cr(FLASH_SER | FLASH_PSIZE_64 | FLASH_START, i));
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error erase sector %u", i);
+		retval = stm32x_erase_sector_start(bank, i);
+		if (retval != ERROR_OK)
 			goto flash_lock;
-		}
 		retval = stm32x_wait_flash_op_queue(bank, FLASH_ERASE_TIMEOUT);
 
 		if (retval != ERROR_OK) {
@@ -516,6 +529,77 @@ flash_lock:
 	return (retval == ERROR_OK) ? retval2 : retval;
 }
 
+/* Each bank of the dual bank devices has its own controller, so one bank
+ * can be erased while the other one is programmed. The sectors are erased
+ * one after the other as for stm32x_erase(), stm32x_erase_poll() starting
+ * the next one. */
+static int stm32x_erase_start(struct flash_bank *bank, unsigned int first,
+		unsigned int last)
+{
+	struct stm32h7x_flash_bank *stm32x_info = bank->driver_priv;
+
+	assert(first <= last && last < bank->num_sectors);
+
+	if (bank->target->state != TARGET_HALTED)
+		return ERROR_TARGET_NOT_HALTED;
+
+	int retval = stm32x_unlock_reg(bank);
+	if (retval == ERROR_OK)
+		retval = stm32x_erase_sector_start(bank, first);
+	if (retval != ERROR_OK) {
+		stm32x_lock_reg(bank);
+		return retval;
+	}
+
+	stm32x_info->erasing = true;
+	stm32x_info->erase_sector = first;
+	stm32x_info->erase_last = last;
+	stm32x_info->erase_deadline = timeval_ms() + FLASH_ERASE_TIMEOUT;
+
+	return ERROR_OK;
+}
+
+static int stm32x_erase_poll(struct flash_bank *bank, bool *done)
+{
+	struct stm32h7x_flash_bank *stm32x_info = bank->driver_priv;
+	uint32_t status;
+
+	*done = !stm32x_info->erasing;
+	if (*done)
+		return ERROR_OK;
+
+	int retval = stm32x_get_flash_status(bank, &status);
+	if (retval == ERROR_OK && (status & FLASH_QW)) {
+		if (timeval_ms() <= stm32x_info->erase_deadline)
+			return ERROR_OK;
+		LOG_ERROR("wait_flash_op_queue, time out expired, status: 0x%" PRIx32, status);
+		retval = ERROR_FAIL;
+	}
+
+	/* the sector is done, check its errors */
+	if (retval == ERROR_OK)
+		retval = stm32x_wait_flash_op_queue(bank, 0);
+	if (retval != ERROR_OK)
+		LOG_ERROR("erase time-out or operation error sector %u",
+				stm32x_info->erase_sector);
+
+	if (retval == ERROR_OK && stm32x_info->erase_sector < stm32x_info->erase_last) {
+		retval = stm32x_erase_sector_start(bank, ++stm32x_info->erase_sector);
+		stm32x_info->erase_deadline = timeval_ms() + FLASH_ERASE_TIMEOUT;
+		if (retval == ERROR_OK)
+			return ERROR_OK;
+	}
+
+	stm32x_info->erasing = false;
+	*done = true;
+
+	int retval2 = stm32x_lock_reg(bank);
+	if (retval2 != ERROR_OK)
+		LOG_ERROR("error during the lock of flash");
+
+	return (retval == ERROR_OK) ? retval2 : retval;
+}
+
 static int stm32x_protect(struct flash_bank *bank, int set, unsigned int first,
 		unsigned int last)
 {
@@ -1201,6 +1285,8 @@ const struct flash_driver stm32h7x_flash = {
 	.commands = stm32h7x_command_handlers,
 	.flash_bank_command = stm32x_flash_bank_command,
 	.erase = stm32x_erase,
+	.erase_start = stm32x_erase_start,
+	.erase_poll = stm32x_erase_poll,
 	.protect = stm32x_protect,
 	.write = stm32x_write,
 	.read = default_flash_read,
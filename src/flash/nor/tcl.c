@@ -176,10 +176,53 @@ COMMAND_HANDLER(handle_flash_probe_command)
 	return retval;
 }
 
+/* time the erase check of the driver against reading the whole bank */
+static int flash_erase_check_benchmark(struct command_invocation *cmd,
+		struct flash_bank *p)
+{
+	struct duration bench;
+
+	duration_start(&bench);
+	int retval = p->driver->erase_check(p);
+	if (retval != ERROR_OK)
+		return retval;
+	duration_measure(&bench);
+	float fast = duration_elapsed(&bench);
+
+	int *is_erased = malloc(p->num_sectors * sizeof(int));
+	if (!is_erased) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	for (unsigned int i = 0; i < p->num_sectors; i++)
+		is_erased[i] = p->sectors[i].is_erased;
+
+	duration_start(&bench);
+	retval = default_flash_mem_blank_check(p);
+	duration_measure(&bench);
+	if (retval == ERROR_OK) {
+		unsigned int mismatches = 0;
+		for (unsigned int i = 0; i < p->num_sectors; i++) {
+			if (is_erased[i] != p->sectors[i].is_erased)
+				mismatches++;
+		}
+
+		command_print(CMD, "driver erase check %fs, read back erase check %fs",
+				fast, duration_elapsed(&bench));
+		if (mismatches)
+			command_print(CMD, "the results differ for %u sectors", mismatches);
+	}
+	free(is_erased);
+
+	return retval;
+}
+
 COMMAND_HANDLER(handle_flash_erase_check_command)
 {
 	bool blank = true;
-	if (CMD_ARGC != 1)
+	if (CMD_ARGC != 1 && CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 2 && strcmp(CMD_ARGV[1], "benchmark"))
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
 	struct flash_bank *p;
@@ -187,7 +230,12 @@ COMMAND_HANDLER(handle_flash_erase_check_command)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = p->driver->erase_check(p);
+	if (CMD_ARGC == 2)
+		retval = flash_erase_check_benchmark(CMD, p);
+	else if (flash_fingerprint_erase_check(p) == ERROR_OK)
+		command_print(CMD, "erase state taken from the flash fingerprints");
+	else
+		retval = p->driver->erase_check(p);
 	if (retval == ERROR_OK)
 		command_print(CMD, "successfully checked erase state");
 	else {
@@ -401,6 +449,7 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	/* flash auto-erase is disabled by default*/
 	int auto_erase = 0;
 	bool auto_unlock = false;
+	bool diff = false;
 
 	while (CMD_ARGC) {
 		if (strcmp(CMD_ARGV[0], "erase") == 0) {
@@ -413,6 +462,13 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 			CMD_ARGV++;
 			CMD_ARGC--;
 			command_print(CMD, "auto unlock enabled");
+		} else if (strcmp(CMD_ARGV[0], "diff") == 0) {
+			/* changed sectors are erased */
+			diff = true;
+			auto_erase = 1;
+			CMD_ARGV++;
+			CMD_ARGC--;
+			command_print(CMD, "differential write enabled");
 		} else
 			break;
 	}
@@ -443,7 +499,7 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 		return retval;
 
 	retval = flash_write_unlock_verify(target, &image, &written, auto_erase,
-		auto_unlock, true, false);
+		auto_unlock, true, false, diff);
 	if (retval != ERROR_OK) {
 		image_close(&image);
 		return retval;
@@ -495,7 +551,7 @@ COMMAND_HANDLER(handle_flash_verify_image_command)
 		return retval;
 
 	retval = flash_write_unlock_verify(target, &image, &verified, false,
-		false, false, true);
+		false, false, true, false);
 	if (retval != ERROR_OK) {
 		image_close(&image);
 		return retval;
@@ -843,19 +899,52 @@ COMMAND_HANDLER(handle_flash_write_bank_command)
 	return retval;
 }
 
+/* flash is read and the file accessed in chunks of this size */
+#define FLASH_STREAM_CHUNK_SIZE	(64 * 1024)
+/* minimum time between two progress messages */
+#define FLASH_STREAM_PROGRESS_MS	2000
+
+struct flash_stream_progress {
+	struct duration bench;
+	int64_t next_report;
+};
+
+static void flash_stream_progress_start(struct flash_stream_progress *progress)
+{
+	duration_start(&progress->bench);
+	progress->next_report = timeval_ms() + FLASH_STREAM_PROGRESS_MS;
+}
+
+/* report the progress of long transfers, and keep the connections alive */
+static void flash_stream_progress_update(struct flash_stream_progress *progress,
+		const char *what, size_t done, size_t total)
+{
+	keep_alive();
+
+	int64_t now = timeval_ms();
+	if (now < progress->next_report || done == total)
+		return;
+	progress->next_report = now + FLASH_STREAM_PROGRESS_MS;
+
+	if (duration_measure(&progress->bench) == ERROR_OK)
+		LOG_INFO("%s %zu of %zu bytes (%u%%, %0.3f KiB/s)", what, done, total,
+				(unsigned int)((uint64_t)done * 100 / total),
+				duration_kbps(&progress->bench, done));
+}
+
 COMMAND_HANDLER(handle_flash_read_bank_command)
 {
 	uint32_t offset;
 	uint8_t *buffer;
 	struct fileio *fileio;
 	uint32_t length;
-	size_t written;
+	size_t written = 0;
 
 	if (CMD_ARGC < 2 || CMD_ARGC > 4)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	struct duration bench;
-	duration_start(&bench);
+	struct flash_stream_progress progress;
+	flash_stream_progress_start(&progress);
 
 	struct flash_bank *p;
 	int retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &p);
@@ -885,19 +974,12 @@ COMMAND_HANDLER(handle_flash_read_bank_command)
 		return ERROR_COMMAND_ARGUMENT_INVALID;
 	}
 
-	buffer = malloc(length);
+	buffer = malloc(MIN(length, FLASH_STREAM_CHUNK_SIZE));
 	if (!buffer) {
 		LOG_ERROR("Out of memory");
 		return ERROR_FAIL;
 	}
 
-	retval = flash_driver_read(p, buffer, offset, length);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Read error");
-		free(buffer);
-		return retval;
-	}
-
 	retval = fileio_open(&fileio, CMD_ARGV[1], FILEIO_WRITE, FILEIO_BINARY);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("Could not open file");
@@ -905,19 +987,37 @@ COMMAND_HANDLER(handle_flash_read_bank_command)
 		return retval;
 	}
 
-	retval = fileio_write(fileio, length, buffer, &written);
+	while (written < length) {
+		uint32_t chunk = MIN(length - written, FLASH_STREAM_CHUNK_SIZE);
+		size_t chunk_written;
+
+		retval = flash_driver_read(p, buffer, offset + written, chunk);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Read error");
+			break;
+		}
+
+		retval = fileio_write(fileio, chunk, buffer, &chunk_written);
+		if (retval != ERROR_OK || chunk_written != chunk) {
+			LOG_ERROR("Could not write file");
+			retval = ERROR_FAIL;
+			break;
+		}
+
+		written += chunk;
+		flash_stream_progress_update(&progress, "read", written, length);
+	}
+
 	fileio_close(fileio);
 	free(buffer);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Could not write file");
-		return ERROR_FAIL;
-	}
+	if (retval != ERROR_OK)
+		return retval;
 
-	if (duration_measure(&bench) == ERROR_OK)
+	if (duration_measure(&progress.bench) == ERROR_OK)
 		command_print(CMD, "wrote %zd bytes to file %s from flash bank %u"
 			" at offset 0x%8.8" PRIx32 " in %fs (%0.3f KiB/s)",
 			written, CMD_ARGV[1], p->bank_number, offset,
-			duration_elapsed(&bench), duration_kbps(&bench, written));
+			duration_elapsed(&progress.bench), duration_kbps(&progress.bench, written));
 
 	return retval;
 }
@@ -931,13 +1031,15 @@ COMMAND_HANDLER(handle_flash_verify_bank_command)
 	size_t read_cnt;
 	size_t filesize;
 	size_t length;
-	int differ;
+	size_t done = 0;
+	int diffs = 0;
+	bool more_diffs = false;
 
 	if (CMD_ARGC < 2 || CMD_ARGC > 3)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	struct duration bench;
-	duration_start(&bench);
+	struct flash_stream_progress progress;
+	flash_stream_progress_start(&progress);
 
 	struct flash_bank *p;
 	int retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &p);
@@ -979,69 +1081,186 @@ COMMAND_HANDLER(handle_flash_verify_bank_command)
 		LOG_INFO("File content exceeds flash bank size. Only comparing the "
 			"first %zu bytes of the file", length);
 
-	buffer_file = malloc(length);
-	if (!buffer_file) {
+	size_t buffer_size = MIN(length, FLASH_STREAM_CHUNK_SIZE);
+	buffer_file = malloc(buffer_size);
+	buffer_flash = malloc(buffer_size);
+	if (!buffer_file || !buffer_flash) {
 		LOG_ERROR("Out of memory");
+		free(buffer_flash);
+		free(buffer_file);
 		fileio_close(fileio);
 		return ERROR_FAIL;
 	}
 
-	retval = fileio_read(fileio, length, buffer_file, &read_cnt);
+	while (done < length) {
+		size_t chunk = MIN(length - done, FLASH_STREAM_CHUNK_SIZE);
+
+		retval = fileio_read(fileio, chunk, buffer_file, &read_cnt);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("File read failure");
+			break;
+		}
+
+		if (read_cnt != chunk) {
+			LOG_ERROR("Short read");
+			retval = ERROR_FAIL;
+			break;
+		}
+
+		retval = flash_driver_read(p, buffer_flash, offset + done, chunk);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Flash read error");
+			break;
+		}
+
+		if (memcmp(buffer_file, buffer_flash, chunk)) {
+			for (size_t t = 0; t < chunk; t++) {
+				if (buffer_flash[t] == buffer_file[t])
+					continue;
+				if (diffs == 128) {
+					more_diffs = true;
+					break;
+				}
+				command_print(CMD, "diff %d address 0x%08zx. Was 0x%02x instead of 0x%02x",
+						diffs, t + done + offset, buffer_flash[t], buffer_file[t]);
+				diffs++;
+			}
+		}
+
+		done += chunk;
+
+		/* the comparison result is known, don't read the rest */
+		if (more_diffs) {
+			command_print(CMD, "More than 128 errors, the rest are not printed.");
+			break;
+		}
+
+		flash_stream_progress_update(&progress, "verified", done, length);
+	}
+
 	fileio_close(fileio);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("File read failure");
-		free(buffer_file);
+	free(buffer_flash);
+	free(buffer_file);
+	if (retval != ERROR_OK)
 		return retval;
-	}
 
-	if (read_cnt != length) {
-		LOG_ERROR("Short read");
-		free(buffer_file);
-		return ERROR_FAIL;
+	if (duration_measure(&progress.bench) == ERROR_OK)
+		command_print(CMD, "read %zd bytes from file %s and flash bank %u"
+			" at offset 0x%8.8" PRIx32 " in %fs (%0.3f KiB/s)",
+			done, CMD_ARGV[1], p->bank_number, offset,
+			duration_elapsed(&progress.bench), duration_kbps(&progress.bench, done));
+
+	command_print(CMD, "contents %s", diffs ? "differ" : "match");
+
+	return diffs ? ERROR_FAIL : ERROR_OK;
+}
+
+static void flash_benchmark_report(struct command_invocation *cmd, const char *phase,
+		struct duration *bench, size_t count)
+{
+	if (duration_measure(bench) == ERROR_OK)
+		command_print(cmd, "%-12s %zu bytes in %fs (%0.3f KiB/s)", phase, count,
+				duration_elapsed(bench), duration_kbps(bench, count));
+	duration_start(bench);
+}
+
+COMMAND_HANDLER(handle_flash_benchmark_command)
+{
+	struct flash_bank *p;
+	uint32_t offset = 0;
+	uint32_t length;
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	int retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &p);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC > 1)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], offset);
+	length = offset < p->size ? p->size - offset : 0;
+	if (CMD_ARGC > 2)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], length);
+
+	/* the range has to cover whole sectors */
+	unsigned int first = p->num_sectors;
+	unsigned int last = p->num_sectors;
+	for (unsigned int i = 0; i < p->num_sectors; i++) {
+		if (p->sectors[i].offset == offset)
+			first = i;
+		if (first < p->num_sectors &&
+				p->sectors[i].offset + p->sectors[i].size == offset + length) {
+			last = i;
+			break;
+		}
+	}
+	if (!length || first == p->num_sectors || last == p->num_sectors) {
+		command_print(CMD, "the range has to start and end at sector boundaries");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
 	}
 
-	buffer_flash = malloc(length);
-	if (!buffer_flash) {
+	uint8_t *pattern = malloc(length);
+	uint8_t *readback = malloc(length);
+	if (!pattern || !readback) {
 		LOG_ERROR("Out of memory");
-		free(buffer_file);
+		free(readback);
+		free(pattern);
 		return ERROR_FAIL;
 	}
 
-	retval = flash_driver_read(p, buffer_flash, offset, length);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Flash read error");
-		free(buffer_flash);
-		free(buffer_file);
-		return retval;
+	/* not compressible and different in every sector */
+	uint32_t seed = 0x12345678 ^ offset;
+	for (uint32_t i = 0; i < length; i++) {
+		seed = seed * 1103515245 + 12345;
+		pattern[i] = seed >> 16;
 	}
 
-	if (duration_measure(&bench) == ERROR_OK)
-		command_print(CMD, "read %zd bytes from file %s and flash bank %u"
-			" at offset 0x%8.8" PRIx32 " in %fs (%0.3f KiB/s)",
-			length, CMD_ARGV[1], p->bank_number, offset,
-			duration_elapsed(&bench), duration_kbps(&bench, length));
+	struct duration bench, total;
+	duration_start(&total);
+	duration_start(&bench);
 
-	differ = memcmp(buffer_file, buffer_flash, length);
-	command_print(CMD, "contents %s", differ ? "differ" : "match");
-	if (differ) {
-		uint32_t t;
-		int diffs = 0;
-		for (t = 0; t < length; t++) {
-			if (buffer_flash[t] == buffer_file[t])
-				continue;
-			command_print(CMD, "diff %d address 0x%08" PRIx32 ". Was 0x%02x instead of 0x%02x",
-					diffs, t + offset, buffer_flash[t], buffer_file[t]);
-			if (diffs++ >= 127) {
-				command_print(CMD, "More than 128 errors, the rest are not printed.");
+	retval = flash_driver_erase(p, first, last);
+	if (retval == ERROR_OK) {
+		flash_benchmark_report(CMD, "erase", &bench, length);
+		retval = p->driver->erase_check(p);
+	}
+	if (retval == ERROR_OK) {
+		flash_benchmark_report(CMD, "erase_check", &bench, p->size);
+		for (unsigned int i = first; i <= last; i++) {
+			if (p->sectors[i].is_erased == 0) {
+				command_print(CMD, "sector %u is not erased", i);
+				retval = ERROR_FAIL;
 				break;
 			}
-			keep_alive();
 		}
 	}
-	free(buffer_flash);
-	free(buffer_file);
+	if (retval == ERROR_OK) {
+		duration_start(&bench);
+		retval = flash_driver_write(p, pattern, offset, length);
+	}
+	if (retval == ERROR_OK) {
+		flash_benchmark_report(CMD, "write", &bench, length);
+		retval = flash_driver_verify(p, pattern, offset, length);
+	}
+	if (retval == ERROR_OK) {
+		flash_benchmark_report(CMD, "verify", &bench, length);
+		retval = flash_driver_read(p, readback, offset, length);
+	}
+	if (retval == ERROR_OK) {
+		flash_benchmark_report(CMD, "read", &bench, length);
+		if (memcmp(pattern, readback, length)) {
+			command_print(CMD, "the flash content read back differs");
+			retval = ERROR_FAIL;
+		}
+	}
+	if (retval == ERROR_OK)
+		flash_benchmark_report(CMD, "total", &total, length);
 
-	return differ ? ERROR_FAIL : ERROR_OK;
+	free(readback);
+	free(pattern);
+
+	return retval;
 }
 
 void flash_set_dirty(void)
@@ -1088,13 +1307,23 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.usage = "bank_id ['sectors']",
 		.help = "Print information about a flash bank.",
 	},
+	{
+		.name = "benchmark",
+		.handler = handle_flash_benchmark_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id [offset [length]]",
+		.help = "Erase, write, verify and read back a test pattern, "
+			"reporting the throughput of each step. "
+			"The previous content is lost.",
+	},
 	{
 		.name = "erase_check",
 		.handler = handle_flash_erase_check_command,
 		.mode = COMMAND_EXEC,
-		.usage = "bank_id",
+		.usage = "bank_id ['benchmark']",
 		.help = "Check erase state of all blocks in a "
-			"flash bank.",
+			"flash bank, optionally timing the check against "
+			"reading back the bank.",
 	},
 	{
 		.name = "erase_sector",
@@ -1182,7 +1411,7 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.name = "write_image",
 		.handler = handle_flash_write_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "[erase] [unlock] filename [offset [file_type]]",
+		.usage = "[erase] [unlock] [diff] filename [offset [file_type]]",
 		.help = "Write an image to flash.  Optionally first unprotect "
 			"and/or erase the region to be used. Allow optional "
 			"offset from beginning of bank (defaults to zero)",
@@ -1364,6 +1593,26 @@ COMMAND_HANDLER(handle_flash_init_command)
 	return flash_init_drivers(CMD_CTX);
 }
 
+COMMAND_HANDLER(handle_flash_fingerprint_cache_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		int retval = flash_fingerprint_set_dir(strcmp(CMD_ARGV[0], "off") ?
+				CMD_ARGV[0] : NULL);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (flash_fingerprint_enabled())
+		command_print(CMD, "flash fingerprints are kept in %s", flash_fingerprint_dir());
+	else
+		command_print(CMD, "flash fingerprint cache is disabled");
+
+	return ERROR_OK;
+}
+
 static const struct command_registration flash_config_command_handlers[] = {
 	{
 		.name = "bank",
@@ -1396,6 +1645,14 @@ static const struct command_registration flash_config_command_handlers[] = {
 		.help = "Returns a list of details about the flash banks.",
 		.usage = "",
 	},
+	{
+		.name = "fingerprint_cache",
+		.mode = COMMAND_ANY,
+		.handler = handle_flash_fingerprint_cache_command,
+		.help = "Keep the checksums of the written flash sectors "
+			"in a directory, or disable it.",
+		.usage = "[directory|'off']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 static const struct command_registration flash_command_handlers[] = {
@@ -5,7 +5,7 @@
 #
 # program utility proc
 # usage: program filename
-# optional args: verify, reset, exit and address
+# optional args: verify, diff, reset, exit and address
 #
 
 lappend _telnet_autocomplete_skip program_error
@@ -27,6 +27,8 @@ proc program {filename args} {
 			set preverify 1
 		} elseif {[string equal $arg "verify"]} {
 			set verify 1
+		} elseif {[string equal $arg "diff"]} {
+			set diff 1
 		} elseif {[string equal $arg "reset"]} {
 			set reset 1
 		} elseif {[string equal $arg "exit"]} {
@@ -68,7 +70,13 @@ proc program {filename args} {
 	if {$needsflash == 1} {
 		echo "** Programming Started **"
 
-		if {[catch {eval flash write_image erase $flash_args}] == 0} {
+		if {[info exists diff]} {
+			set write_args "erase diff $flash_args"
+		} else {
+			set write_args "erase $flash_args"
+		}
+
+		if {[catch {eval flash write_image $write_args}] == 0} {
 			echo "** Programming Finished **"
 			if {[info exists verify]} {
 				# verify phase
@@ -101,8 +109,8 @@ proc program {filename args} {
 	return
 }
 
-add_help_text program "write an image to flash, address is only required for binary images. verify, reset, exit are optional"
-add_usage_text program "<filename> \[address\] \[pre-verify\] \[verify\] \[reset\] \[exit\]"
+add_help_text program "write an image to flash, address is only required for binary images. verify, diff, reset, exit are optional"
+add_usage_text program "<filename> \[address\] \[pre-verify\] \[verify\] \[diff\] \[reset\] \[exit\]"
 
 # stm32[f0x|f3x] uses the same flash driver as the stm32f1x
 proc stm32f0x args { eval stm32f1x $args }
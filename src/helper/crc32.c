@@ -13,38 +13,137 @@
 #endif
 
 #include "crc32.h"
+#include "types.h"
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
-static uint32_t crc_le_step(uint32_t poly, uint32_t crc, uint32_t data_in,
-		unsigned int data_bits)
+/* number of polynomials whose tables are kept at the same time */
+#define CRC32_TABLE_SLOTS	4
+
+/*
+ * Slice-by-8 lookup tables: t[0] is the classic byte-wise table, t[k]
+ * advances the CRC of a byte followed by k zero bytes, so that 8 bytes are
+ * folded in with 8 independent lookups.
+ */
+struct crc32_table {
+	uint32_t poly;
+	bool msb_first;
+	bool valid;
+	uint32_t t[8][256];
+};
+
+static struct crc32_table crc32_tables[CRC32_TABLE_SLOTS];
+static unsigned int crc32_next_slot;
+
+static void crc32_table_init(struct crc32_table *table, uint32_t poly, bool msb_first)
+{
+	for (unsigned int i = 0; i < 256; i++) {
+		uint32_t c;
+		if (msb_first) {
+			c = i << 24;
+			for (unsigned int j = 0; j < 8; j++)
+				c = (c & 0x80000000) ? (c << 1) ^ poly : c << 1;
+		} else {
+			c = i;
+			for (unsigned int j = 0; j < 8; j++)
+				c = (c & 0x1) ? (c >> 1) ^ poly : c >> 1;
+		}
+		table->t[0][i] = c;
+	}
+
+	for (unsigned int k = 1; k < 8; k++) {
+		for (unsigned int i = 0; i < 256; i++) {
+			uint32_t c = table->t[k - 1][i];
+			if (msb_first)
+				table->t[k][i] = (c << 8) ^ table->t[0][c >> 24];
+			else
+				table->t[k][i] = (c >> 8) ^ table->t[0][c & 0xff];
+		}
+	}
+
+	table->poly = poly;
+	table->msb_first = msb_first;
+	table->valid = true;
+}
+
+static const struct crc32_table *crc32_get_table(uint32_t poly, bool msb_first)
 {
-	for (unsigned int i = 0; i < data_bits; i++) {
-		uint32_t d, c;
-		d = ((data_in >> i) & 0x1) ? 0xffffffff : 0;
-		c = (crc & 0x1) ? 0xffffffff : 0;
-		crc = crc >> 1;
-		crc = crc ^ ((d ^ c) & poly);
+	for (unsigned int i = 0; i < CRC32_TABLE_SLOTS; i++) {
+		struct crc32_table *table = &crc32_tables[i];
+		if (table->valid && table->poly == poly && table->msb_first == msb_first)
+			return table;
 	}
 
-	return crc;
+	/* replace the oldest table, few polynomials are in use at once */
+	struct crc32_table *table = &crc32_tables[crc32_next_slot];
+	crc32_next_slot = (crc32_next_slot + 1) % CRC32_TABLE_SLOTS;
+	crc32_table_init(table, poly, msb_first);
+
+	return table;
+}
+
+/* fold 8 bytes, given as two words holding the first byte in their LSB */
+static inline uint32_t crc32_le_fold8(const struct crc32_table *table, uint32_t crc,
+		uint32_t one, uint32_t two)
+{
+	one ^= crc;
+	return table->t[7][one & 0xff] ^ table->t[6][(one >> 8) & 0xff] ^
+		table->t[5][(one >> 16) & 0xff] ^ table->t[4][one >> 24] ^
+		table->t[3][two & 0xff] ^ table->t[2][(two >> 8) & 0xff] ^
+		table->t[1][(two >> 16) & 0xff] ^ table->t[0][two >> 24];
+}
+
+static inline uint32_t crc32_le_fold4(const struct crc32_table *table, uint32_t crc,
+		uint32_t word)
+{
+	crc ^= word;
+	return table->t[3][crc & 0xff] ^ table->t[2][(crc >> 8) & 0xff] ^
+		table->t[1][(crc >> 16) & 0xff] ^ table->t[0][crc >> 24];
 }
 
 uint32_t crc32_le(uint32_t poly, uint32_t seed, const void *_data,
 		size_t data_len)
 {
+	const struct crc32_table *table = crc32_get_table(poly, false);
+
 	if (((uintptr_t)_data & 0x3) || (data_len & 0x3)) {
-		/* data is unaligned, processing data one byte at a time */
+		/* data is unaligned, processing data in memory order */
 		const uint8_t *data = _data;
-		for (size_t i = 0; i < data_len; i++)
-			seed = crc_le_step(poly, seed, data[i], 8);
+		for (; data_len >= 8; data_len -= 8, data += 8)
+			seed = crc32_le_fold8(table, seed, le_to_h_u32(data), le_to_h_u32(data + 4));
+		while (data_len--)
+			seed = (seed >> 8) ^ table->t[0][(seed ^ *data++) & 0xff];
 	} else {
-		/* data is aligned, processing 32 bit at a time */
+		/* data is aligned, processing 32 bit words starting from their LSB */
 		data_len >>= 2;
 		const uint32_t *data = _data;
-		for (size_t i = 0; i < data_len; i++)
-			seed = crc_le_step(poly, seed, data[i], 32);
+		for (; data_len >= 2; data_len -= 2, data += 2)
+			seed = crc32_le_fold8(table, seed, data[0], data[1]);
+		if (data_len)
+			seed = crc32_le_fold4(table, seed, data[0]);
 	}
 
 	return seed;
 }
+
+uint32_t crc32_be(uint32_t poly, uint32_t seed, const void *_data,
+		size_t data_len)
+{
+	const struct crc32_table *table = crc32_get_table(poly, true);
+	const uint8_t *data = _data;
+
+	for (; data_len >= 8; data_len -= 8, data += 8) {
+		uint32_t one = be_to_h_u32(data) ^ seed;
+		uint32_t two = be_to_h_u32(data + 4);
+		seed = table->t[7][one >> 24] ^ table->t[6][(one >> 16) & 0xff] ^
+			table->t[5][(one >> 8) & 0xff] ^ table->t[4][one & 0xff] ^
+			table->t[3][two >> 24] ^ table->t[2][(two >> 16) & 0xff] ^
+			table->t[1][(two >> 8) & 0xff] ^ table->t[0][two & 0xff];
+	}
+
+	while (data_len--)
+		seed = (seed << 8) ^ table->t[0][((seed >> 24) ^ *data++) & 0xff];
+
+	return seed;
+}
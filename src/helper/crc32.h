@@ -12,7 +12,7 @@
 #include <stddef.h>
 
 /** @file
- * A generic CRC32 implementation
+ * A generic table driven CRC32 implementation
  */
 
 /**
@@ -20,6 +20,12 @@
  */
 #define CRC32_POLY_LE	0xedb88320
 
+/**
+ * CRC32 polynomial used MSB first by GDB and by the target checksum
+ * algorithms, see image_calculate_checksum()
+ */
+#define CRC32_POLY_BE	0x04c11db7
+
 /**
  * Calculate the CRC32 value of the given data
  * @param	poly		The polynomial of the CRC
@@ -34,4 +40,16 @@
 uint32_t crc32_le(uint32_t poly, uint32_t seed, const void *data,
 		size_t data_len);
 
+/**
+ * Calculate the CRC32 value of the given data, shifting the bits in MSB first
+ * @param	poly		The polynomial of the CRC, not reflected
+ * @param	seed		The seed to use
+ * @param	data		The data to calculate the CRC32 of
+ * @param	data_len	The length of the data in @p data in bytes
+ * @return	The CRC value of the first @p data_len bytes at @p data
+ * @note	As crc32_le(), this can be used incrementally.
+ */
+uint32_t crc32_be(uint32_t poly, uint32_t seed, const void *data,
+		size_t data_len);
+
 #endif /* OPENOCD_HELPER_CRC32_H */
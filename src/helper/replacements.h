@@ -134,6 +134,12 @@ struct sockaddr_un {
 	char sun_path[UNIX_PATH_LEN];
 };
 
+/* Windows does not declare struct iovec */
+struct iovec {
+	void *iov_base;
+	size_t iov_len;
+};
+
 /* win32 systems do not support ETIMEDOUT */
 
 #ifndef ETIMEDOUT
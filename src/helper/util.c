@@ -10,10 +10,13 @@
 #include "config.h"
 #endif
 
+#include "crc32.h"
 #include "log.h"
 #include "time_support.h"
 #include "util.h"
 
+#include <stdlib.h>
+
 COMMAND_HANDLER(handler_util_ms)
 {
 	if (CMD_ARGC != 0)
@@ -24,6 +27,60 @@ COMMAND_HANDLER(handler_util_ms)
 	return ERROR_OK;
 }
 
+/* CRC of "123456789" without final inversion, for the check of the engine */
+#define CRC32_CHECK_LE	0x340bc6d9
+#define CRC32_CHECK_BE	0x0376e6e7
+
+COMMAND_HANDLER(handler_util_crc32_benchmark)
+{
+	unsigned int size_kib = 4096;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], size_kib);
+	if (!size_kib || size_kib > 1024 * 1024)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	static const char check[] = "123456789";
+	if (crc32_le(CRC32_POLY_LE, 0xffffffff, check, 9) != CRC32_CHECK_LE ||
+			crc32_be(CRC32_POLY_BE, 0xffffffff, check, 9) != CRC32_CHECK_BE) {
+		command_print(CMD, "CRC32 check values do not match");
+		return ERROR_FAIL;
+	}
+
+	size_t size = (size_t)size_kib * 1024;
+	uint8_t *data = malloc(size + 1);
+	if (!data) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	for (size_t i = 0; i < size + 1; i++)
+		data[i] = i * 131 + (i >> 8);
+
+	/* the flash and image CRC, the aligned and unaligned little endian CRC */
+	static const char * const names[] = { "be", "le aligned", "le unaligned" };
+	for (unsigned int i = 0; i < ARRAY_SIZE(names); i++) {
+		struct duration bench;
+		uint32_t crc;
+
+		duration_start(&bench);
+		if (i == 0)
+			crc = crc32_be(CRC32_POLY_BE, 0xffffffff, data, size);
+		else
+			crc = crc32_le(CRC32_POLY_LE, 0xffffffff, data + i - 1, size);
+		duration_measure(&bench);
+
+		command_print(CMD, "crc32 %-12s 0x%08" PRIx32 " %u KiB in %fs (%0.3f KiB/s)",
+				names[i], crc, size_kib, duration_elapsed(&bench),
+				duration_kbps(&bench, size));
+	}
+
+	free(data);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration util_command_handlers[] = {
 	{
 		.name = "ms",
@@ -33,6 +90,14 @@ static const struct command_registration util_command_handlers[] = {
 			"Returns ever increasing milliseconds. Used to calculate differences in time.",
 		.usage = "",
 	},
+	{
+		.name = "crc32_benchmark",
+		.mode = COMMAND_ANY,
+		.handler = handler_util_crc32_benchmark,
+		.help =
+			"Checks the host CRC32 engine and measures its throughput.",
+		.usage = "[size_kib]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -13,6 +13,7 @@
 
 #include "adapter.h"
 #include "jtag.h"
+#include "commands.h"
 #include "minidriver.h"
 #include "interface.h"
 #include "interfaces.h"
@@ -200,6 +201,8 @@ int adapter_quit(void)
 		t = n;
 	}
 
+	jtag_command_queue_free();
+
 	return ERROR_OK;
 }
 
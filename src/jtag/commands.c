@@ -26,12 +26,40 @@
 struct cmd_queue_page {
 	struct cmd_queue_page *next;
 	void *address;
+	size_t size;
 	size_t used;
 };
 
+/*
+ * The pages of the command queue are kept when the queue is reset, up to
+ * the most ever used at once, so a flush does not return them to malloc()
+ * only to get them back for the next queue. Pages larger than
+ * CMD_QUEUE_PAGE_SIZE, for a single large allocation, are released.
+ */
 #define CMD_QUEUE_PAGE_SIZE (1024 * 1024)
 static struct cmd_queue_page *cmd_queue_pages;
-static struct cmd_queue_page *cmd_queue_pages_tail;
+static struct cmd_queue_page *cmd_queue_current;
+
+/*
+ * Buffers of jtag_build_buffer(), handed back with jtag_free_buffer() for
+ * the next scans. Drivers keeping more buffers at once get the others from
+ * malloc().
+ */
+#define SCAN_BUFFER_POOL_SIZE 8
+#define SCAN_BUFFER_MIN_SIZE 64
+
+struct scan_buffer {
+	uint8_t *address;
+	size_t size;
+	bool used;
+};
+
+static struct scan_buffer scan_buffer_pool[SCAN_BUFFER_POOL_SIZE];
+
+static struct jtag_queue_stats queue_stats_current;
+static struct jtag_queue_stats queue_stats_last;
+static struct jtag_queue_stats queue_stats_total;
+static unsigned int queue_stats_flushes;
 
 struct jtag_command *jtag_command_queue;
 static struct jtag_command **next_command_pointer = &jtag_command_queue;
@@ -65,7 +93,6 @@ void jtag_queue_command(struct jtag_command *cmd)
 
 void *cmd_queue_alloc(size_t size)
 {
-	struct cmd_queue_page **p_page = &cmd_queue_pages;
 	int offset;
 	uint8_t *t;
 
@@ -101,29 +128,72 @@ void *cmd_queue_alloc(size_t size)
 	size = (size + ALIGN_SIZE - 1) & (~(ALIGN_SIZE - 1));
 	/* Done... */
 
-	if (*p_page) {
-		p_page = &cmd_queue_pages_tail;
-		if (CMD_QUEUE_PAGE_SIZE - (*p_page)->used < size)
-			p_page = &((*p_page)->next);
+	struct cmd_queue_page *page = cmd_queue_current;
+	if (page && page->size - page->used < size) {
+		/* the following pages are free, reuse the next one if it fits */
+		if (page->next && page->next->size >= size) {
+			page = page->next;
+			cmd_queue_current = page;
+		} else {
+			page = NULL;
+		}
 	}
 
-	if (!*p_page) {
-		*p_page = malloc(sizeof(struct cmd_queue_page));
-		(*p_page)->used = 0;
+	if (!page) {
 		size_t alloc_size = (size < CMD_QUEUE_PAGE_SIZE) ?
 					CMD_QUEUE_PAGE_SIZE : size;
-		(*p_page)->address = malloc(alloc_size);
-		(*p_page)->next = NULL;
-		cmd_queue_pages_tail = *p_page;
+		page = malloc(sizeof(struct cmd_queue_page));
+		if (page)
+			page->address = malloc(alloc_size);
+		if (!page || !page->address) {
+			free(page);
+			LOG_ERROR("Out of memory");
+			return NULL;
+		}
+		page->size = alloc_size;
+		page->used = 0;
+
+		/* insert after the current page, before the free ones */
+		if (cmd_queue_current) {
+			page->next = cmd_queue_current->next;
+			cmd_queue_current->next = page;
+		} else {
+			page->next = cmd_queue_pages;
+			cmd_queue_pages = page;
+		}
+		cmd_queue_current = page;
+		queue_stats_current.pages++;
 	}
 
-	offset = (*p_page)->used;
-	(*p_page)->used += size;
+	offset = page->used;
+	page->used += size;
+	queue_stats_current.allocations++;
+	queue_stats_current.bytes += size;
 
-	t = (*p_page)->address;
+	t = page->address;
 	return t + offset;
 }
 
+/* Empty the pages, keeping those of the default size */
+static void cmd_queue_reset_pages(void)
+{
+	struct cmd_queue_page **p_page = &cmd_queue_pages;
+
+	while (*p_page) {
+		struct cmd_queue_page *page = *p_page;
+		if (page->size > CMD_QUEUE_PAGE_SIZE) {
+			*p_page = page->next;
+			free(page->address);
+			free(page);
+		} else {
+			page->used = 0;
+			p_page = &page->next;
+		}
+	}
+
+	cmd_queue_current = cmd_queue_pages;
+}
+
 static void cmd_queue_free(void)
 {
 	struct cmd_queue_page *page = cmd_queue_pages;
@@ -136,15 +206,104 @@ static void cmd_queue_free(void)
 	}
 
 	cmd_queue_pages = NULL;
-	cmd_queue_pages_tail = NULL;
+	cmd_queue_current = NULL;
 }
 
 void jtag_command_queue_reset(void)
 {
-	cmd_queue_free();
+	cmd_queue_reset_pages();
 
 	jtag_command_queue = NULL;
 	next_command_pointer = &jtag_command_queue;
+
+	queue_stats_last = queue_stats_current;
+	queue_stats_total.allocations += queue_stats_current.allocations;
+	queue_stats_total.bytes += queue_stats_current.bytes;
+	queue_stats_total.pages += queue_stats_current.pages;
+	queue_stats_total.scan_buffers += queue_stats_current.scan_buffers;
+	queue_stats_total.scan_buffer_mallocs += queue_stats_current.scan_buffer_mallocs;
+	memset(&queue_stats_current, 0, sizeof(queue_stats_current));
+	queue_stats_flushes++;
+}
+
+void jtag_command_queue_free(void)
+{
+	cmd_queue_free();
+
+	for (unsigned int i = 0; i < SCAN_BUFFER_POOL_SIZE; i++) {
+		free(scan_buffer_pool[i].address);
+		scan_buffer_pool[i].address = NULL;
+		scan_buffer_pool[i].size = 0;
+		scan_buffer_pool[i].used = false;
+	}
+}
+
+void jtag_command_queue_stats(struct jtag_queue_stats *last,
+		struct jtag_queue_stats *total, unsigned int *flushes)
+{
+	*last = queue_stats_last;
+	*total = queue_stats_total;
+	*flushes = queue_stats_flushes;
+}
+
+void jtag_command_queue_stats_reset(void)
+{
+	memset(&queue_stats_last, 0, sizeof(queue_stats_last));
+	memset(&queue_stats_total, 0, sizeof(queue_stats_total));
+	queue_stats_flushes = 0;
+}
+
+static uint8_t *jtag_alloc_buffer(size_t size)
+{
+	struct scan_buffer *free_entry = NULL;
+
+	queue_stats_current.scan_buffers++;
+
+	for (unsigned int i = 0; i < SCAN_BUFFER_POOL_SIZE; i++) {
+		struct scan_buffer *entry = &scan_buffer_pool[i];
+		if (entry->used)
+			continue;
+		/* not an empty entry, even for a zero size */
+		if (entry->address && entry->size >= size) {
+			entry->used = true;
+			memset(entry->address, 0, size);
+			return entry->address;
+		}
+		if (!free_entry)
+			free_entry = entry;
+	}
+
+	queue_stats_current.scan_buffer_mallocs++;
+
+	if (!free_entry)
+		return calloc(1, size);
+
+	/* replace the unused buffer, too small, by a larger one */
+	size_t alloc_size = MAX(size, SCAN_BUFFER_MIN_SIZE);
+	uint8_t *buffer = calloc(1, alloc_size);
+	if (!buffer)
+		return NULL;
+	free(free_entry->address);
+	free_entry->address = buffer;
+	free_entry->size = alloc_size;
+	free_entry->used = true;
+
+	return buffer;
+}
+
+void jtag_free_buffer(uint8_t *buffer)
+{
+	if (!buffer)
+		return;
+
+	for (unsigned int i = 0; i < SCAN_BUFFER_POOL_SIZE; i++) {
+		if (scan_buffer_pool[i].address == buffer) {
+			scan_buffer_pool[i].used = false;
+			return;
+		}
+	}
+
+	free(buffer);
 }
 
 /**
@@ -192,7 +351,7 @@ int jtag_build_buffer(const struct scan_command *cmd, uint8_t **buffer)
 	int i;
 
 	bit_count = jtag_scan_size(cmd);
-	*buffer = calloc(1, DIV_ROUND_UP(bit_count, 8));
+	*buffer = jtag_alloc_buffer(DIV_ROUND_UP(bit_count, 8));
 
 	bit_count = 0;
 
@@ -243,7 +402,11 @@ int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd)
 		if (cmd->fields[i].in_value) {
 			int num_bits = cmd->fields[i].num_bits;
 			uint8_t *captured = buf_set_buf(buffer, bit_count,
-					malloc(DIV_ROUND_UP(num_bits, 8)), 0, num_bits);
+					cmd->fields[i].in_value, 0, num_bits);
+
+			/* mask out bits that don't belong to the field */
+			if (num_bits % 8)
+				captured[num_bits / 8] &= (1 << (num_bits % 8)) - 1;
 
 			if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
 				char *char_buf = buf_to_hex_str(captured,
@@ -255,11 +418,6 @@ int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd)
 						i, num_bits, char_buf);
 				free(char_buf);
 			}
-
-			if (cmd->fields[i].in_value)
-				buf_cpy(captured, cmd->fields[i].in_value, num_bits);
-
-			free(captured);
 		}
 		bit_count += cmd->fields[i].num_bits;
 	}
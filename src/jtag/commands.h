@@ -152,15 +152,36 @@ struct jtag_command {
 /** The current queue of jtag_command_s structures. */
 extern struct jtag_command *jtag_command_queue;
 
+/** Allocations of a flush of the command queue. */
+struct jtag_queue_stats {
+	/* allocations from cmd_queue_alloc() */
+	uint64_t allocations;
+	uint64_t bytes;
+	/* pages from malloc() for cmd_queue_alloc() */
+	uint64_t pages;
+	/* buffers of jtag_build_buffer(), and those not from the pool */
+	uint64_t scan_buffers;
+	uint64_t scan_buffer_mallocs;
+};
+
 void *cmd_queue_alloc(size_t size);
 
 void jtag_queue_command(struct jtag_command *cmd);
 void jtag_command_queue_reset(void);
+/** Release the memory kept for the next command queues. */
+void jtag_command_queue_free(void);
+
+/** Get the allocations of the last flush and since the statistics reset. */
+void jtag_command_queue_stats(struct jtag_queue_stats *last,
+		struct jtag_queue_stats *total, unsigned int *flushes);
+void jtag_command_queue_stats_reset(void);
 
 void jtag_scan_field_clone(struct scan_field *dst, const struct scan_field *src);
 enum scan_type jtag_scan_type(const struct scan_command *cmd);
 int jtag_scan_size(const struct scan_command *cmd);
 int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd);
 int jtag_build_buffer(const struct scan_command *cmd, uint8_t **buffer);
+/** Hand back a buffer of jtag_build_buffer() for the next scans. */
+void jtag_free_buffer(uint8_t *buffer);
 
 #endif /* OPENOCD_JTAG_COMMANDS_H */
@@ -224,6 +224,22 @@ static int am335xgpio_write(int tck, int tms, int tdi)
 	return ERROR_OK;
 }
 
+static int am335xgpio_scan(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		unsigned int num_bits)
+{
+	for (unsigned int i = 0; i < num_bits; i++) {
+		int tms_bit = bitbang_get_bit(tms, i);
+		int tdi_bit = bitbang_get_bit(tdi, i);
+
+		am335xgpio_write(0, tms_bit, tdi_bit);
+		if (tdo)
+			bitbang_set_bit(tdo, i, get_gpio_value(&adapter_gpio_config[ADAPTER_GPIO_IDX_TDO]));
+		am335xgpio_write(1, tms_bit, tdi_bit);
+	}
+
+	return ERROR_OK;
+}
+
 static int am335xgpio_swd_write(int swclk, int swdio)
 {
 	set_gpio_value(&adapter_gpio_config[ADAPTER_GPIO_IDX_SWDIO], swdio);
@@ -284,6 +300,7 @@ static int am335xgpio_blink(int on)
 static struct bitbang_interface am335xgpio_bitbang = {
 	.read = am335xgpio_read,
 	.write = am335xgpio_write,
+	.scan = am335xgpio_scan,
 	.swdio_read = am335xgpio_swdio_read,
 	.swdio_drive = am335xgpio_swdio_drive,
 	.swd_write = am335xgpio_swd_write,
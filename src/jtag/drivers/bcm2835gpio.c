@@ -198,6 +198,22 @@ static int bcm2835gpio_write(int tck, int tms, int tdi)
 	return ERROR_OK;
 }
 
+static int bcm2835gpio_scan(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		unsigned int num_bits)
+{
+	for (unsigned int i = 0; i < num_bits; i++) {
+		int tms_bit = bitbang_get_bit(tms, i);
+		int tdi_bit = bitbang_get_bit(tdi, i);
+
+		bcm2835gpio_write(0, tms_bit, tdi_bit);
+		if (tdo)
+			bitbang_set_bit(tdo, i, bcm2835gpio_read() == BB_HIGH);
+		bcm2835gpio_write(1, tms_bit, tdi_bit);
+	}
+
+	return ERROR_OK;
+}
+
 /* Requires push-pull drive mode for swclk and swdio */
 static int bcm2835gpio_swd_write_fast(int swclk, int swdio)
 {
@@ -418,6 +434,7 @@ static int bcm2835gpio_blink(int on)
 static struct bitbang_interface bcm2835gpio_bitbang = {
 	.read = bcm2835gpio_read,
 	.write = bcm2835gpio_write,
+	.scan = bcm2835gpio_scan,
 	.swdio_read = bcm2835_swdio_read,
 	.swdio_drive = bcm2835_swdio_drive,
 	.swd_write = bcm2835gpio_swd_write_generic,
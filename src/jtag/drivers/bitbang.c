@@ -60,18 +60,68 @@ static void bitbang_end_state(tap_state_t state)
 	tap_set_end_state(state);
 }
 
+/**
+ * Clock @a num_bits bits with TMS and TDI taken from @a tms and @a tdi, and
+ * TDO sampled into @a tdo, through the bulk interface when the driver has
+ * one. NULL vectors stand for all zero bits and for TDO not needed.
+ * TCK is left high.
+ */
+static int bitbang_clock_bits(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		unsigned int num_bits)
+{
+	if (bitbang_interface->scan)
+		return bitbang_interface->scan(tms, tdi, tdo, num_bits);
+
+	size_t buffered = 0;
+	for (unsigned int i = 0; i < num_bits; i++) {
+		int tms_bit = bitbang_get_bit(tms, i);
+		int tdi_bit = bitbang_get_bit(tdi, i);
+
+		if (bitbang_interface->write(0, tms_bit, tdi_bit) != ERROR_OK)
+			return ERROR_FAIL;
+
+		if (tdo) {
+			if (bitbang_interface->buf_size) {
+				if (bitbang_interface->sample() != ERROR_OK)
+					return ERROR_FAIL;
+				buffered++;
+			} else {
+				bb_value_t value = bitbang_interface->read();
+				if (value == BB_ERROR)
+					return ERROR_FAIL;
+				bitbang_set_bit(tdo, i, value == BB_HIGH);
+			}
+		}
+
+		if (bitbang_interface->write(1, tms_bit, tdi_bit) != ERROR_OK)
+			return ERROR_FAIL;
+
+		if (tdo && bitbang_interface->buf_size &&
+				(buffered == bitbang_interface->buf_size || i == num_bits - 1)) {
+			for (unsigned int j = i + 1 - buffered; j <= i; j++) {
+				bb_value_t value = bitbang_interface->read_sample();
+				if (value == BB_ERROR)
+					return ERROR_FAIL;
+				bitbang_set_bit(tdo, j, value == BB_HIGH);
+			}
+			buffered = 0;
+		}
+	}
+
+	return ERROR_OK;
+}
+
 static int bitbang_state_move(int skip)
 {
-	int i = 0, tms = 0;
 	uint8_t tms_scan = tap_get_tms_path(tap_get_state(), tap_get_end_state());
 	int tms_count = tap_get_tms_path_len(tap_get_state(), tap_get_end_state());
+	int tms = 0;
 
-	for (i = skip; i < tms_count; i++) {
-		tms = (tms_scan >> i) & 1;
-		if (bitbang_interface->write(0, tms, 0) != ERROR_OK)
-			return ERROR_FAIL;
-		if (bitbang_interface->write(1, tms, 0) != ERROR_OK)
+	if (skip < tms_count) {
+		tms_scan >>= skip;
+		if (bitbang_clock_bits(&tms_scan, NULL, NULL, tms_count - skip) != ERROR_OK)
 			return ERROR_FAIL;
+		tms = (tms_scan >> (tms_count - skip - 1)) & 1;
 	}
 	if (bitbang_interface->write(CLOCK_IDLE(), tms, 0) != ERROR_OK)
 		return ERROR_FAIL;
@@ -92,12 +142,10 @@ static int bitbang_execute_tms(struct jtag_command *cmd)
 	LOG_DEBUG_IO("TMS: %d bits", num_bits);
 
 	int tms = 0;
-	for (unsigned i = 0; i < num_bits; i++) {
-		tms = ((bits[i/8] >> (i % 8)) & 1);
-		if (bitbang_interface->write(0, tms, 0) != ERROR_OK)
-			return ERROR_FAIL;
-		if (bitbang_interface->write(1, tms, 0) != ERROR_OK)
+	if (num_bits) {
+		if (bitbang_clock_bits(bits, NULL, NULL, num_bits) != ERROR_OK)
 			return ERROR_FAIL;
+		tms = bitbang_get_bit(bits, num_bits - 1);
 	}
 	if (bitbang_interface->write(CLOCK_IDLE(), tms, 0) != ERROR_OK)
 		return ERROR_FAIL;
@@ -143,8 +191,6 @@ static int bitbang_path_move(struct pathmove_command *cmd)
 
 static int bitbang_runtest(int num_cycles)
 {
-	int i;
-
 	tap_state_t saved_end_state = tap_get_end_state();
 
 	/* only do a state_move when we're not already in IDLE */
@@ -155,12 +201,8 @@ static int bitbang_runtest(int num_cycles)
 	}
 
 	/* execute num_cycles */
-	for (i = 0; i < num_cycles; i++) {
-		if (bitbang_interface->write(0, 0, 0) != ERROR_OK)
-			return ERROR_FAIL;
-		if (bitbang_interface->write(1, 0, 0) != ERROR_OK)
-			return ERROR_FAIL;
-	}
+	if (num_cycles > 0 && bitbang_clock_bits(NULL, NULL, NULL, num_cycles) != ERROR_OK)
+		return ERROR_FAIL;
 	if (bitbang_interface->write(CLOCK_IDLE(), 0, 0) != ERROR_OK)
 		return ERROR_FAIL;
 
@@ -193,7 +235,6 @@ static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 		unsigned scan_size)
 {
 	tap_state_t saved_end_state = tap_get_end_state();
-	unsigned bit_cnt;
 
 	if (!((!ir_scan &&
 			(tap_get_state() == TAP_DRSHIFT)) ||
@@ -208,64 +249,34 @@ static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 		bitbang_end_state(saved_end_state);
 	}
 
-	size_t buffered = 0;
-	for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
-		int tms = (bit_cnt == scan_size-1) ? 1 : 0;
-		int tdi;
-		int bytec = bit_cnt/8;
-		int bcval = 1 << (bit_cnt % 8);
-
-		/* if we're just reading the scan, but don't care about the output
-		 * default to outputting 'low', this also makes valgrind traces more readable,
-		 * as it removes the dependency on an uninitialised value
-		 */
-		tdi = 0;
-		if ((type != SCAN_IN) && (buffer[bytec] & bcval))
-			tdi = 1;
-
-		if (bitbang_interface->write(0, tms, tdi) != ERROR_OK)
+	/* if we're just reading the scan, but don't care about the output
+	 * default to outputting 'low', this also makes valgrind traces more readable,
+	 * as it removes the dependency on an uninitialised value
+	 */
+	const uint8_t *tdi = (type != SCAN_IN) ? buffer : NULL;
+	uint8_t *tdo = (type != SCAN_OUT) ? buffer : NULL;
+
+	/* TMS is only set on the last bit, to leave the shift state; a scan
+	 * without bits clocks nothing */
+	uint8_t tms_byte = 0;
+	uint8_t *tms = &tms_byte;
+	if (scan_size > 8) {
+		tms = calloc(DIV_ROUND_UP(scan_size, 8), 1);
+		if (!tms) {
+			LOG_ERROR("Out of memory");
 			return ERROR_FAIL;
-
-		if (type != SCAN_OUT) {
-			if (bitbang_interface->buf_size) {
-				if (bitbang_interface->sample() != ERROR_OK)
-					return ERROR_FAIL;
-				buffered++;
-			} else {
-				switch (bitbang_interface->read()) {
-					case BB_LOW:
-						buffer[bytec] &= ~bcval;
-						break;
-					case BB_HIGH:
-						buffer[bytec] |= bcval;
-						break;
-					default:
-						return ERROR_FAIL;
-				}
-			}
 		}
+	}
 
-		if (bitbang_interface->write(1, tms, tdi) != ERROR_OK)
-			return ERROR_FAIL;
-
-		if (type != SCAN_OUT && bitbang_interface->buf_size &&
-				(buffered == bitbang_interface->buf_size ||
-				 bit_cnt == scan_size - 1)) {
-			for (unsigned i = bit_cnt + 1 - buffered; i <= bit_cnt; i++) {
-				switch (bitbang_interface->read_sample()) {
-					case BB_LOW:
-						buffer[i/8] &= ~(1 << (i % 8));
-						break;
-					case BB_HIGH:
-						buffer[i/8] |= 1 << (i % 8);
-						break;
-					default:
-						return ERROR_FAIL;
-				}
-			}
-			buffered = 0;
-		}
+	int retval = ERROR_OK;
+	if (scan_size) {
+		bitbang_set_bit(tms, scan_size - 1, 1);
+		retval = bitbang_clock_bits(tms, tdi, tdo, scan_size);
 	}
+	if (tms != &tms_byte)
+		free(tms);
+	if (retval != ERROR_OK)
+		return retval;
 
 	if (tap_get_state() != tap_get_end_state()) {
 		/* we *KNOW* the above loop transitioned out of
@@ -347,7 +358,7 @@ int bitbang_execute_queue(void)
 					return ERROR_FAIL;
 				if (jtag_read_buffer(buffer, cmd->cmd.scan) != ERROR_OK)
 					retval = ERROR_JTAG_QUEUE_FAILED;
-				free(buffer);
+				jtag_free_buffer(buffer);
 				break;
 			case JTAG_SLEEP:
 				LOG_DEBUG_IO("sleep %" PRIu32, cmd->cmd.sleep->us);
@@ -54,8 +54,31 @@ struct bitbang_interface {
 
 	/** Set SWCLK and SWDIO to the given value. */
 	int (*swd_write)(int swclk, int swdio);
+
+	/** Clock @a num_bits bits in one call (optional). For each bit, TCK is
+	 * set low with TMS and TDI taken from the LSB first vectors @a tms and
+	 * @a tdi, TDO is sampled into @a tdo, then TCK is set high. A NULL @a tms
+	 * or @a tdi holds all zero bits, a NULL @a tdo means TDO is not needed.
+	 * @a tdo may be the same buffer as @a tdi. */
+	int (*scan)(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+			unsigned int num_bits);
 };
 
+/** @returns bit @a i of the LSB first vector @a bits, 0 if @a bits is NULL. */
+static inline int bitbang_get_bit(const uint8_t *bits, unsigned int i)
+{
+	return bits ? (bits[i / 8] >> (i % 8)) & 1 : 0;
+}
+
+/** Set bit @a i of the LSB first vector @a bits to @a value. */
+static inline void bitbang_set_bit(uint8_t *bits, unsigned int i, int value)
+{
+	if (value)
+		bits[i / 8] |= 1 << (i % 8);
+	else
+		bits[i / 8] &= ~(1 << (i % 8));
+}
+
 extern const struct swd_driver bitbang_swd;
 
 int bitbang_execute_queue(void);
@@ -774,7 +774,7 @@ static int buspirate_tap_execute(void)
 			return ERROR_JTAG_QUEUE_FAILED;
 		}
 
-		free(buffer);
+		jtag_free_buffer(buffer);
 	}
 	buspirate_tap_init();
 	return ERROR_OK;
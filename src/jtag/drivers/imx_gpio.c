@@ -74,6 +74,8 @@ static inline bool gpio_level(int g)
 
 static bb_value_t imx_gpio_read(void);
 static int imx_gpio_write(int tck, int tms, int tdi);
+static int imx_gpio_scan(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		unsigned int num_bits);
 
 static int imx_gpio_swdio_read(void);
 static void imx_gpio_swdio_drive(bool is_output);
@@ -85,6 +87,7 @@ static int imx_gpio_quit(void);
 static struct bitbang_interface imx_gpio_bitbang = {
 	.read = imx_gpio_read,
 	.write = imx_gpio_write,
+	.scan = imx_gpio_scan,
 	.swdio_read = imx_gpio_swdio_read,
 	.swdio_drive = imx_gpio_swdio_drive,
 	.swd_write = imx_gpio_swd_write,
@@ -135,6 +138,22 @@ static int imx_gpio_write(int tck, int tms, int tdi)
 	return ERROR_OK;
 }
 
+static int imx_gpio_scan(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		unsigned int num_bits)
+{
+	for (unsigned int i = 0; i < num_bits; i++) {
+		int tms_bit = bitbang_get_bit(tms, i);
+		int tdi_bit = bitbang_get_bit(tdi, i);
+
+		imx_gpio_write(0, tms_bit, tdi_bit);
+		if (tdo)
+			bitbang_set_bit(tdo, i, gpio_level(tdo_gpio));
+		imx_gpio_write(1, tms_bit, tdi_bit);
+	}
+
+	return ERROR_OK;
+}
+
 static int imx_gpio_swd_write(int swclk, int swdio)
 {
 	swdio ? gpio_set(swdio_gpio) : gpio_clear(swdio_gpio);
@@ -159,7 +159,7 @@ static int jtag_dpi_scan(struct scan_command *cmd)
 	}
 
 out:
-	free(data_buf);
+	jtag_free_buffer(data_buf);
 	return ret;
 }
 
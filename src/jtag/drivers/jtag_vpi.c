@@ -22,6 +22,7 @@
 #include <netinet/tcp.h>
 #endif
 
+#include "helper/bits.h"
 #include "helper/replacements.h"
 
 #define NO_TAP_SHIFT	0
@@ -37,6 +38,32 @@
 #define CMD_SCAN_CHAIN		2
 #define CMD_SCAN_CHAIN_FLIP_TMS	3
 #define CMD_STOP_SIMU		4
+#define CMD_CAPABILITIES	5
+#define CMD_FRAME		6
+
+/*
+ * Batched mode, used when both "jtag_vpi batch on" is configured and the
+ * server reports JTAG_VPI_CAP_FRAME in the length of its answer to
+ * CMD_CAPABILITIES.
+ *
+ * The whole command queue is then sent as a single CMD_FRAME packet, whose
+ * length is the number of bytes following the packet and nb_bits the number
+ * of records there. Each record is the command, with the flags above its low
+ * byte, and the number of bits, both 32 bit little endian, followed by the
+ * (nb_bits + 7) / 8 bytes of TDI or TMS unless JTAG_VPI_FLAG_NO_TDI is set in
+ * the command, in which case TDI is held high. The server answers the frame
+ * with the TDO bytes of the records having JTAG_VPI_FLAG_TDO set, concatenated,
+ * and nothing if there are none.
+ */
+#define JTAG_VPI_CAP_FRAME	BIT(0)
+#define JTAG_VPI_FLAG_TDO	BIT(8)
+#define JTAG_VPI_FLAG_NO_TDI	BIT(9)
+
+/* larger frames, or frames with more TDO in their answer, are sent in several
+ * parts, so that the answer fits in socket buffers */
+#define JTAG_VPI_FRAME_MAX_SIZE	(64 * 1024)
+/* a simulator can take a while to answer its first request */
+#define JTAG_VPI_CAPABILITIES_TIMEOUT_MS	10000
 
 /* jtag_vpi server port and address to connect to */
 static int server_port = DEFAULT_SERVER_PORT;
@@ -45,6 +72,10 @@ static char *server_address;
 /* Send CMD_STOP_SIMU to server when OpenOCD exits? */
 static bool stop_sim_on_exit;
 
+/* Batched mode requested by the configuration, and supported by the server */
+static bool batch_requested;
+static bool batch_mode;
+
 static int sockfd;
 static struct sockaddr_in serv_addr;
 
@@ -66,6 +97,26 @@ struct vpi_cmd {
 	};
 };
 
+/* Scan whose TDO is in the answer to the frame */
+struct jtag_vpi_pending_scan {
+	struct scan_command *cmd;
+	uint8_t *buf;
+	unsigned int offset;
+	unsigned int nb_bytes;
+};
+
+/* The frame being built, kept allocated across the queues */
+static uint8_t *frame;
+static unsigned int frame_used;
+static unsigned int frame_size;
+static unsigned int frame_records;
+static unsigned int frame_answer_size;
+static uint8_t *frame_answer;
+static unsigned int frame_answer_alloc;
+static struct jtag_vpi_pending_scan *pending_scans;
+static unsigned int num_pending_scans;
+static unsigned int max_pending_scans;
+
 static char *jtag_vpi_cmd_to_str(int cmd_num)
 {
 	switch (cmd_num) {
@@ -79,15 +130,52 @@ static char *jtag_vpi_cmd_to_str(int cmd_num)
 		return "CMD_SCAN_CHAIN_FLIP_TMS";
 	case CMD_STOP_SIMU:
 		return "CMD_STOP_SIMU";
+	case CMD_CAPABILITIES:
+		return "CMD_CAPABILITIES";
+	case CMD_FRAME:
+		return "CMD_FRAME";
 	default:
 		return "<unknown>";
 	}
 }
 
-static int jtag_vpi_send_cmd(struct vpi_cmd *vpi)
+static int jtag_vpi_send(const void *data, unsigned int len)
 {
 	int retval;
 
+retry_write:
+	retval = write_socket(sockfd, data, len);
+
+	if (retval < 0) {
+		/* Account for the case when socket write is interrupted. */
+#ifdef _WIN32
+		int wsa_err = WSAGetLastError();
+		if (wsa_err == WSAEINTR)
+			goto retry_write;
+#else
+		if (errno == EINTR)
+			goto retry_write;
+#endif
+		/* Otherwise this is an error using the socket, most likely fatal
+		   for the connection. B*/
+		log_socket_error("jtag_vpi xmit");
+		/* TODO: Clean way how adapter drivers can report fatal errors
+		   to upper layers of OpenOCD and let it perform an orderly shutdown? */
+		exit(-1);
+	} else if (retval < (int)len) {
+		/* This means we could not send all data, which is most likely fatal
+		   for the jtag_vpi connection (the underlying TCP connection likely not
+		   usable anymore) */
+		LOG_ERROR("jtag_vpi: Could not send all data through jtag_vpi connection.");
+		exit(-1);
+	}
+
+	/* Otherwise the packet has been sent successfully. */
+	return ERROR_OK;
+}
+
+static int jtag_vpi_send_cmd(struct vpi_cmd *vpi)
+{
 	/* Optional low-level JTAG debug */
 	if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
 		if (vpi->nb_bits > 0) {
@@ -125,43 +213,15 @@ static int jtag_vpi_send_cmd(struct vpi_cmd *vpi)
 	h_u32_to_le(vpi->length_buf, vpi->length);
 	h_u32_to_le(vpi->nb_bits_buf, vpi->nb_bits);
 
-retry_write:
-	retval = write_socket(sockfd, vpi, sizeof(struct vpi_cmd));
-
-	if (retval < 0) {
-		/* Account for the case when socket write is interrupted. */
-#ifdef _WIN32
-		int wsa_err = WSAGetLastError();
-		if (wsa_err == WSAEINTR)
-			goto retry_write;
-#else
-		if (errno == EINTR)
-			goto retry_write;
-#endif
-		/* Otherwise this is an error using the socket, most likely fatal
-		   for the connection. B*/
-		log_socket_error("jtag_vpi xmit");
-		/* TODO: Clean way how adapter drivers can report fatal errors
-		   to upper layers of OpenOCD and let it perform an orderly shutdown? */
-		exit(-1);
-	} else if (retval < (int)sizeof(struct vpi_cmd)) {
-		/* This means we could not send all data, which is most likely fatal
-		   for the jtag_vpi connection (the underlying TCP connection likely not
-		   usable anymore) */
-		LOG_ERROR("jtag_vpi: Could not send all data through jtag_vpi connection.");
-		exit(-1);
-	}
-
-	/* Otherwise the packet has been sent successfully. */
-	return ERROR_OK;
+	return jtag_vpi_send(vpi, sizeof(struct vpi_cmd));
 }
 
-static int jtag_vpi_receive_cmd(struct vpi_cmd *vpi)
+static int jtag_vpi_receive(void *data, unsigned int len)
 {
-	unsigned bytes_buffered = 0;
-	while (bytes_buffered < sizeof(struct vpi_cmd)) {
-		int bytes_to_receive = sizeof(struct vpi_cmd) - bytes_buffered;
-		int retval = read_socket(sockfd, ((char *)vpi) + bytes_buffered, bytes_to_receive);
+	unsigned int bytes_buffered = 0;
+	while (bytes_buffered < len) {
+		int bytes_to_receive = len - bytes_buffered;
+		int retval = read_socket(sockfd, ((char *)data) + bytes_buffered, bytes_to_receive);
 		if (retval < 0) {
 #ifdef _WIN32
 			int wsa_err = WSAGetLastError();
@@ -187,6 +247,15 @@ static int jtag_vpi_receive_cmd(struct vpi_cmd *vpi)
 		bytes_buffered += retval;
 	}
 
+	return ERROR_OK;
+}
+
+static int jtag_vpi_receive_cmd(struct vpi_cmd *vpi)
+{
+	int retval = jtag_vpi_receive(vpi, sizeof(struct vpi_cmd));
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* Use little endian when transmitting/receiving jtag_vpi cmds. */
 	vpi->cmd = le_to_h_u32(vpi->cmd_buf);
 	vpi->length = le_to_h_u32(vpi->length_buf);
@@ -195,6 +264,165 @@ static int jtag_vpi_receive_cmd(struct vpi_cmd *vpi)
 	return ERROR_OK;
 }
 
+/**
+ * jtag_vpi_frame_add - append a command to the frame
+ * @param cmd the command
+ * @param bits TDI or TMS bits, or NULL to hold TDI high
+ * @param nb_bits number of bits
+ * @param offset where to store the offset of TDO in the answer, or NULL if
+ * TDO is not needed
+ */
+static int jtag_vpi_frame_add(uint32_t cmd, const uint8_t *bits, uint32_t nb_bits,
+		unsigned int *offset)
+{
+	unsigned int nb_bytes = DIV_ROUND_UP(nb_bits, 8);
+	unsigned int size = 8 + (bits ? nb_bytes : 0);
+
+	if (frame_used + size > frame_size) {
+		unsigned int new_size = MAX(frame_size * 2, frame_used + size);
+		uint8_t *new_frame = realloc(frame, new_size);
+		if (!new_frame) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		frame = new_frame;
+		frame_size = new_size;
+	}
+
+	if (!bits)
+		cmd |= JTAG_VPI_FLAG_NO_TDI;
+	if (offset) {
+		cmd |= JTAG_VPI_FLAG_TDO;
+		*offset = frame_answer_size;
+		frame_answer_size += nb_bytes;
+	}
+
+	h_u32_to_le(frame + frame_used, cmd);
+	h_u32_to_le(frame + frame_used + 4, nb_bits);
+	if (bits)
+		memcpy(frame + frame_used + 8, bits, nb_bytes);
+	frame_used += size;
+	frame_records++;
+
+	return ERROR_OK;
+}
+
+/**
+ * jtag_vpi_frame_flush - send the frame and complete its scans
+ *
+ * The TDO of the pending scans is taken from the answer of the server and
+ * their buffers are released, also on error.
+ */
+static int jtag_vpi_frame_flush(void)
+{
+	int retval = ERROR_OK;
+
+	if (frame_records) {
+		struct vpi_cmd vpi;
+		memset(&vpi, 0, sizeof(struct vpi_cmd));
+		vpi.cmd = CMD_FRAME;
+		vpi.length = frame_used;
+		vpi.nb_bits = frame_records;
+
+		LOG_DEBUG_IO("sending JTAG VPI frame: %u commands, %u bytes, %u bytes of TDO",
+				frame_records, frame_used, frame_answer_size);
+
+		retval = jtag_vpi_send_cmd(&vpi);
+		if (retval == ERROR_OK)
+			retval = jtag_vpi_send(frame, frame_used);
+	}
+
+	if (retval == ERROR_OK && frame_answer_size > frame_answer_alloc) {
+		free(frame_answer);
+		frame_answer = malloc(frame_answer_size);
+		frame_answer_alloc = frame_answer ? frame_answer_size : 0;
+		if (!frame_answer) {
+			LOG_ERROR("Out of memory");
+			retval = ERROR_FAIL;
+		}
+	}
+
+	if (retval == ERROR_OK && frame_answer_size)
+		retval = jtag_vpi_receive(frame_answer, frame_answer_size);
+
+	for (unsigned int i = 0; i < num_pending_scans; i++) {
+		struct jtag_vpi_pending_scan *scan = &pending_scans[i];
+
+		if (retval == ERROR_OK) {
+			memcpy(scan->buf, frame_answer + scan->offset, scan->nb_bytes);
+			retval = jtag_read_buffer(scan->buf, scan->cmd);
+		}
+		jtag_free_buffer(scan->buf);
+	}
+
+	frame_used = 0;
+	frame_records = 0;
+	frame_answer_size = 0;
+	num_pending_scans = 0;
+
+	return retval;
+}
+
+/**
+ * jtag_vpi_frame_scan - append a scan to the frame
+ * @param cmd the scan command
+ * @param buf the buffer of the scan, now owned by the frame
+ * @param scan_bits number of bits of the scan
+ * @param tap_shift
+ *
+ * Only the scans reading TDO are completed when the frame is flushed.
+ */
+static int jtag_vpi_frame_scan(struct scan_command *cmd, uint8_t *buf, int scan_bits,
+		int tap_shift)
+{
+	uint32_t vpi_cmd = tap_shift ? CMD_SCAN_CHAIN_FLIP_TMS : CMD_SCAN_CHAIN;
+
+	if (!(jtag_scan_type(cmd) & SCAN_IN)) {
+		int retval = jtag_vpi_frame_add(vpi_cmd, buf, scan_bits, NULL);
+		jtag_free_buffer(buf);
+		return retval;
+	}
+
+	if (num_pending_scans == max_pending_scans) {
+		unsigned int new_max = MAX(2 * max_pending_scans, 16);
+		struct jtag_vpi_pending_scan *new_pending = realloc(pending_scans,
+				new_max * sizeof(*pending_scans));
+		if (!new_pending) {
+			LOG_ERROR("Out of memory");
+			jtag_free_buffer(buf);
+			return ERROR_FAIL;
+		}
+		pending_scans = new_pending;
+		max_pending_scans = new_max;
+	}
+
+	/* keep the answer within the socket buffers */
+	unsigned int nb_bytes = DIV_ROUND_UP(scan_bits, 8);
+	if (frame_answer_size && frame_answer_size + nb_bytes > JTAG_VPI_FRAME_MAX_SIZE) {
+		int retval = jtag_vpi_frame_flush();
+		if (retval != ERROR_OK) {
+			jtag_free_buffer(buf);
+			return retval;
+		}
+	}
+
+	struct jtag_vpi_pending_scan *scan = &pending_scans[num_pending_scans];
+	int retval = jtag_vpi_frame_add(vpi_cmd, buf, scan_bits, &scan->offset);
+	if (retval != ERROR_OK) {
+		jtag_free_buffer(buf);
+		return retval;
+	}
+	scan->cmd = cmd;
+	scan->buf = buf;
+	scan->nb_bytes = nb_bytes;
+	num_pending_scans++;
+
+	if (frame_used >= JTAG_VPI_FRAME_MAX_SIZE)
+		return jtag_vpi_frame_flush();
+
+	return ERROR_OK;
+}
+
 /**
  * jtag_vpi_reset - ask to reset the JTAG device
  * @param trst 1 if TRST is to be asserted
@@ -205,6 +433,9 @@ static int jtag_vpi_reset(int trst, int srst)
 	struct vpi_cmd vpi;
 	memset(&vpi, 0, sizeof(struct vpi_cmd));
 
+	if (batch_mode)
+		return jtag_vpi_frame_add(CMD_RESET, NULL, 0, NULL);
+
 	vpi.cmd = CMD_RESET;
 	vpi.length = 0;
 	return jtag_vpi_send_cmd(&vpi);
@@ -226,6 +457,9 @@ static int jtag_vpi_tms_seq(const uint8_t *bits, int nb_bits)
 	struct vpi_cmd vpi;
 	int nb_bytes;
 
+	if (batch_mode)
+		return jtag_vpi_frame_add(CMD_TMS_SEQ, bits, nb_bits, NULL);
+
 	memset(&vpi, 0, sizeof(struct vpi_cmd));
 	nb_bytes = DIV_ROUND_UP(nb_bits, 8);
 
@@ -340,6 +574,13 @@ static int jtag_vpi_queue_tdi(uint8_t *bits, int nb_bits, int tap_shift)
 	int nb_xfer = DIV_ROUND_UP(nb_bits, XFERT_MAX_SIZE * 8);
 	int retval;
 
+	/* the frame has no size limit, TDO is only read by jtag_vpi_frame_scan() */
+	if (batch_mode) {
+		assert(!bits);
+		return jtag_vpi_frame_add(tap_shift ? CMD_SCAN_CHAIN_FLIP_TMS : CMD_SCAN_CHAIN,
+				NULL, nb_bits, NULL);
+	}
+
 	while (nb_xfer) {
 		if (nb_xfer ==  1) {
 			retval = jtag_vpi_queue_tdi_xfer(bits, nb_bits, tap_shift);
@@ -400,7 +641,14 @@ static int jtag_vpi_scan(struct scan_command *cmd)
 			return retval;
 	}
 
-	if (cmd->end_state == TAP_DRSHIFT) {
+	if (batch_mode) {
+		/* the frame completes the scan, even on error */
+		retval = jtag_vpi_frame_scan(cmd, buf, scan_bits,
+				cmd->end_state == TAP_DRSHIFT ? NO_TAP_SHIFT : TAP_SHIFT);
+		buf = NULL;
+		if (retval != ERROR_OK)
+			return retval;
+	} else if (cmd->end_state == TAP_DRSHIFT) {
 		retval = jtag_vpi_queue_tdi(buf, scan_bits, NO_TAP_SHIFT);
 		if (retval != ERROR_OK)
 			return retval;
@@ -425,11 +673,13 @@ static int jtag_vpi_scan(struct scan_command *cmd)
 			tap_set_state(TAP_DRPAUSE);
 	}
 
-	retval = jtag_read_buffer(buf, cmd);
-	if (retval != ERROR_OK)
-		return retval;
+	if (buf) {
+		retval = jtag_read_buffer(buf, cmd);
+		if (retval != ERROR_OK)
+			return retval;
 
-	free(buf);
+		jtag_free_buffer(buf);
+	}
 
 	if (cmd->end_state != TAP_DRSHIFT) {
 		retval = jtag_vpi_state_move(cmd->end_state);
@@ -508,6 +758,8 @@ static int jtag_vpi_execute_queue(void)
 			retval = jtag_vpi_tms(cmd->cmd.tms);
 			break;
 		case JTAG_SLEEP:
+			if (batch_mode)
+				retval = jtag_vpi_frame_flush();
 			jtag_sleep(cmd->cmd.sleep->us);
 			break;
 		case JTAG_SCAN:
@@ -521,9 +773,64 @@ static int jtag_vpi_execute_queue(void)
 		}
 	}
 
+	if (batch_mode) {
+		int flush_retval = jtag_vpi_frame_flush();
+		if (retval == ERROR_OK)
+			retval = flush_retval;
+	}
+
 	return retval;
 }
 
+/* Ask the server for its capabilities. A server not knowing the command
+ * does not answer, and since a late answer would be taken as the reply to
+ * a scan, the initialization then fails. */
+static int jtag_vpi_get_capabilities(void)
+{
+	struct vpi_cmd vpi;
+	memset(&vpi, 0, sizeof(struct vpi_cmd));
+	vpi.cmd = CMD_CAPABILITIES;
+
+	int retval = jtag_vpi_send_cmd(&vpi);
+	if (retval != ERROR_OK)
+		return retval;
+
+	fd_set read_fds;
+	FD_ZERO(&read_fds);
+	FD_SET(sockfd, &read_fds);
+	struct timeval tv = {
+		.tv_sec = JTAG_VPI_CAPABILITIES_TIMEOUT_MS / 1000,
+		.tv_usec = (JTAG_VPI_CAPABILITIES_TIMEOUT_MS % 1000) * 1000,
+	};
+
+	retval = socket_select(sockfd + 1, &read_fds, NULL, NULL, &tv);
+	if (retval < 0) {
+		log_socket_error("jtag_vpi select");
+		return ERROR_FAIL;
+	}
+	if (retval == 0) {
+		LOG_ERROR("jtag_vpi: no answer to the capabilities request, "
+				"turn 'jtag_vpi batch' off for this server");
+		return ERROR_FAIL;
+	}
+
+	retval = jtag_vpi_receive_cmd(&vpi);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (vpi.cmd != CMD_CAPABILITIES) {
+		LOG_ERROR("jtag_vpi: unexpected answer %s to the capabilities request",
+				jtag_vpi_cmd_to_str(vpi.cmd));
+		return ERROR_FAIL;
+	}
+
+	batch_mode = vpi.length & JTAG_VPI_CAP_FRAME;
+	LOG_INFO("jtag_vpi: server capabilities 0x%" PRIx32 ", %s mode", vpi.length,
+			batch_mode ? "batched" : "packet");
+
+	return ERROR_OK;
+}
+
 static int jtag_vpi_init(void)
 {
 	int flag = 1;
@@ -564,6 +871,12 @@ static int jtag_vpi_init(void)
 
 	LOG_INFO("jtag_vpi: Connection to %s : %u successful", server_address, server_port);
 
+	batch_mode = false;
+	if (batch_requested && jtag_vpi_get_capabilities() != ERROR_OK) {
+		close_socket(sockfd);
+		return ERROR_FAIL;
+	}
+
 	return ERROR_OK;
 }
 
@@ -588,6 +901,15 @@ static int jtag_vpi_quit(void)
 		log_socket_error("jtag_vpi");
 	}
 	free(server_address);
+	free(frame);
+	frame = NULL;
+	frame_size = 0;
+	free(frame_answer);
+	frame_answer = NULL;
+	frame_answer_alloc = 0;
+	free(pending_scans);
+	pending_scans = NULL;
+	max_pending_scans = 0;
 	return ERROR_OK;
 }
 
@@ -630,6 +952,18 @@ COMMAND_HANDLER(jtag_vpi_stop_sim_on_exit_handler)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(jtag_vpi_batch_handler)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], batch_requested);
+
+	command_print(CMD, "jtag_vpi batched mode %s", batch_requested ? "on" : "off");
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_vpi_subcommand_handlers[] = {
 	{
 		.name = "set_port",
@@ -653,6 +987,14 @@ static const struct command_registration jtag_vpi_subcommand_handlers[] = {
 			"before OpenOCD exits (default: off)",
 		.usage = "<on|off>",
 	},
+	{
+		.name = "batch",
+		.handler = &jtag_vpi_batch_handler,
+		.mode = COMMAND_CONFIG,
+		.help = "Send each command queue as one frame, if the server "
+			"supports it (default: off)",
+		.usage = "[on|off]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
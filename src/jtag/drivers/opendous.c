@@ -678,7 +678,7 @@ int opendous_tap_execute(void)
 				return ERROR_JTAG_QUEUE_FAILED;
 			}
 
-			free(pending_scan_result->buffer);
+			jtag_free_buffer(pending_scan_result->buffer);
 		}
 
 		opendous_tap_init();
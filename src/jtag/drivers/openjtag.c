@@ -580,7 +580,7 @@ static int openjtag_execute_tap_queue(void)
 #endif
 			jtag_read_buffer(buffer, openjtag_scan_result_buffer[res_count].command);
 
-			free(openjtag_scan_result_buffer[res_count].buffer);
+			jtag_free_buffer(openjtag_scan_result_buffer[res_count].buffer);
 
 			res_count++;
 		}
@@ -16,14 +16,31 @@
 #endif
 #include "helper/system.h"
 #include "helper/replacements.h"
+#include "helper/bits.h"
+#include "helper/time_support.h"
 #include <jtag/interface.h>
 #include "bitbang.h"
 
 /* arbitrary limit on host name length: */
 #define REMOTE_BITBANG_HOST_MAX 255
 
+/* binary protocol extension, see doc/manual/jtag/drivers/remote_bitbang.txt */
+#define REMOTE_BITBANG_CMD_VERSION	'V'
+#define REMOTE_BITBANG_CMD_VECTOR	'X'
+#define REMOTE_BITBANG_VECTOR_TMS	BIT(0)
+#define REMOTE_BITBANG_VECTOR_TDI	BIT(1)
+#define REMOTE_BITBANG_VECTOR_TDO	BIT(2)
+/* bits clocked by one vector command, its TDO fits the socket buffers */
+#define REMOTE_BITBANG_VECTOR_MAX_BITS	(4096 * 8)
+/* a simulator can take a while to answer its first request */
+#define REMOTE_BITBANG_VERSION_TIMEOUT_MS	10000
+
 static char *remote_bitbang_host;
 static char *remote_bitbang_port;
+/* the binary protocol is requested by the configuration */
+static bool remote_bitbang_use_binary;
+/* the binary protocol is supported by the remote end */
+static bool remote_bitbang_binary;
 
 static int remote_bitbang_fd;
 static uint8_t remote_bitbang_send_buf[512];
@@ -148,6 +165,51 @@ static int remote_bitbang_queue(int c, flush_bool_t flush)
 	return ERROR_OK;
 }
 
+static int remote_bitbang_queue_bytes(const uint8_t *data, unsigned int len)
+{
+	while (len) {
+		unsigned int count = MIN(len, ARRAY_SIZE(remote_bitbang_send_buf) -
+				remote_bitbang_send_buf_used);
+
+		memcpy(remote_bitbang_send_buf + remote_bitbang_send_buf_used, data, count);
+		remote_bitbang_send_buf_used += count;
+		data += count;
+		len -= count;
+
+		if (remote_bitbang_send_buf_used == ARRAY_SIZE(remote_bitbang_send_buf) &&
+				remote_bitbang_flush() != ERROR_OK)
+			return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+static int remote_bitbang_recv_byte(void)
+{
+	int c = (unsigned char)remote_bitbang_recv_buf[remote_bitbang_recv_buf_start];
+	remote_bitbang_recv_buf_start =
+		(remote_bitbang_recv_buf_start + 1) % sizeof(remote_bitbang_recv_buf);
+	return c;
+}
+
+/* Read @a len bytes, waiting for them. */
+static int remote_bitbang_read_bytes(uint8_t *buf, unsigned int len)
+{
+	for (unsigned int i = 0; i < len; i++) {
+		if (remote_bitbang_recv_buf_empty()) {
+			if (remote_bitbang_fill_buf(BLOCK) != ERROR_OK)
+				return ERROR_FAIL;
+			if (remote_bitbang_recv_buf_empty()) {
+				LOG_ERROR("remote_bitbang: connection closed by the remote end");
+				return ERROR_FAIL;
+			}
+		}
+		buf[i] = remote_bitbang_recv_byte();
+	}
+
+	return ERROR_OK;
+}
+
 static int remote_bitbang_quit(void)
 {
 	if (remote_bitbang_queue('Q', FLUSH_SEND_BUF) == ERROR_FAIL)
@@ -194,10 +256,7 @@ static bb_value_t remote_bitbang_read_sample(void)
 			return BB_ERROR;
 	}
 	assert(!remote_bitbang_recv_buf_empty());
-	int c = remote_bitbang_recv_buf[remote_bitbang_recv_buf_start];
-	remote_bitbang_recv_buf_start =
-		(remote_bitbang_recv_buf_start + 1) % sizeof(remote_bitbang_recv_buf);
-	return char_to_int(c);
+	return char_to_int(remote_bitbang_recv_byte());
 }
 
 static int remote_bitbang_write(int tck, int tms, int tdi)
@@ -206,6 +265,91 @@ static int remote_bitbang_write(int tck, int tms, int tdi)
 	return remote_bitbang_queue(c, NO_FLUSH);
 }
 
+/* Send the scan as vector commands of the binary protocol, with TDO coming
+ * back packed in one response per command. */
+static int remote_bitbang_scan_binary(const uint8_t *tms, const uint8_t *tdi,
+		uint8_t *tdo, unsigned int num_bits)
+{
+	for (unsigned int start = 0; start < num_bits; start += REMOTE_BITBANG_VECTOR_MAX_BITS) {
+		unsigned int bits = MIN(num_bits - start, REMOTE_BITBANG_VECTOR_MAX_BITS);
+		unsigned int bytes = DIV_ROUND_UP(bits, 8);
+		uint8_t header[6];
+
+		header[0] = REMOTE_BITBANG_CMD_VECTOR;
+		header[1] = (tms ? REMOTE_BITBANG_VECTOR_TMS : 0) |
+			(tdi ? REMOTE_BITBANG_VECTOR_TDI : 0) |
+			(tdo ? REMOTE_BITBANG_VECTOR_TDO : 0);
+		h_u32_to_le(header + 2, bits);
+
+		if (remote_bitbang_queue_bytes(header, sizeof(header)) != ERROR_OK)
+			return ERROR_FAIL;
+		if (tms && remote_bitbang_queue_bytes(tms + start / 8, bytes) != ERROR_OK)
+			return ERROR_FAIL;
+		if (tdi && remote_bitbang_queue_bytes(tdi + start / 8, bytes) != ERROR_OK)
+			return ERROR_FAIL;
+
+		if (!tdo)
+			continue;
+
+		/* the bits beyond the scan in the last byte are kept */
+		unsigned int full_bytes = bits / 8;
+		if (remote_bitbang_read_bytes(tdo + start / 8, full_bytes) != ERROR_OK)
+			return ERROR_FAIL;
+		if (bits % 8) {
+			uint8_t last;
+			if (remote_bitbang_read_bytes(&last, 1) != ERROR_OK)
+				return ERROR_FAIL;
+			uint8_t mask = (1 << (bits % 8)) - 1;
+			uint8_t *dst = tdo + start / 8 + full_bytes;
+			*dst = (*dst & ~mask) | (last & mask);
+		}
+	}
+
+	return ERROR_OK;
+}
+
+/* Queue the characters of a whole scan, reading TDO back once per chunk of
+ * samples that fits the receive buffer. */
+static int remote_bitbang_scan(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+		unsigned int num_bits)
+{
+	if (remote_bitbang_binary)
+		return remote_bitbang_scan_binary(tms, tdi, tdo, num_bits);
+
+	const unsigned int chunk = sizeof(remote_bitbang_recv_buf) - 1;
+
+	for (unsigned int start = 0; start < num_bits; start += chunk) {
+		unsigned int end = MIN(start + chunk, num_bits);
+
+		if (tdo && remote_bitbang_fill_buf(NO_BLOCK) != ERROR_OK)
+			return ERROR_FAIL;
+
+		for (unsigned int i = start; i < end; i++) {
+			char c = '0' + (bitbang_get_bit(tms, i) ? 0x2 : 0x0) +
+				(bitbang_get_bit(tdi, i) ? 0x1 : 0x0);
+
+			if (remote_bitbang_queue(c, NO_FLUSH) != ERROR_OK)
+				return ERROR_FAIL;
+			if (tdo && remote_bitbang_queue('R', NO_FLUSH) != ERROR_OK)
+				return ERROR_FAIL;
+			if (remote_bitbang_queue(c + 0x4, NO_FLUSH) != ERROR_OK)
+				return ERROR_FAIL;
+		}
+
+		if (!tdo)
+			continue;
+
+		for (unsigned int i = start; i < end; i++) {
+			bb_value_t value = remote_bitbang_read_sample();
+			if (value == BB_ERROR)
+				return ERROR_FAIL;
+			bitbang_set_bit(tdo, i, value == BB_HIGH);
+		}
+	}
+
+	return ERROR_OK;
+}
+
 static int remote_bitbang_reset(int trst, int srst)
 {
 	char c = 'r' + ((trst ? 0x2 : 0x0) | (srst ? 0x1 : 0x0));
@@ -225,6 +369,7 @@ static struct bitbang_interface remote_bitbang_bitbang = {
 	.sample = &remote_bitbang_sample,
 	.read_sample = &remote_bitbang_read_sample,
 	.write = &remote_bitbang_write,
+	.scan = &remote_bitbang_scan,
 	.blink = &remote_bitbang_blink,
 };
 
@@ -305,6 +450,56 @@ static int remote_bitbang_init_unix(void)
 	return fd;
 }
 
+/* Ask the remote end for the version of the binary protocol. A remote end
+ * not supporting it ignores the request and does not answer. Since a late
+ * answer would be taken as TDO by the ASCII protocol, there is no fallback. */
+static int remote_bitbang_negotiate(void)
+{
+	remote_bitbang_binary = false;
+
+	if (remote_bitbang_queue(REMOTE_BITBANG_CMD_VERSION, FLUSH_SEND_BUF) != ERROR_OK)
+		return ERROR_FAIL;
+
+	int64_t deadline = timeval_ms() + REMOTE_BITBANG_VERSION_TIMEOUT_MS;
+	unsigned int available = 0;
+	while (available < 2 && timeval_ms() < deadline) {
+		fd_set read_fds;
+		FD_ZERO(&read_fds);
+		FD_SET(remote_bitbang_fd, &read_fds);
+		struct timeval tv = { .tv_sec = 0, .tv_usec = 100000 };
+
+		int retval = socket_select(remote_bitbang_fd + 1, &read_fds, NULL, NULL, &tv);
+		if (retval < 0) {
+			log_socket_error("select");
+			return ERROR_FAIL;
+		}
+		if (retval == 0)
+			continue;
+
+		if (remote_bitbang_fill_buf(NO_BLOCK) != ERROR_OK)
+			return ERROR_FAIL;
+		available = (remote_bitbang_recv_buf_end + sizeof(remote_bitbang_recv_buf) -
+				remote_bitbang_recv_buf_start) % sizeof(remote_bitbang_recv_buf);
+	}
+
+	if (available < 2) {
+		LOG_ERROR("remote_bitbang: no answer to the binary protocol request, "
+				"turn 'remote_bitbang binary' off for this remote end");
+		return ERROR_FAIL;
+	}
+
+	int c = remote_bitbang_recv_byte();
+	int version = remote_bitbang_recv_byte();
+	if (c != REMOTE_BITBANG_CMD_VERSION || version < '1') {
+		LOG_ERROR("remote_bitbang: invalid version response: %c%c", c, version);
+		return ERROR_FAIL;
+	}
+
+	LOG_INFO("remote_bitbang: using binary protocol version %c", version);
+	remote_bitbang_binary = true;
+	return ERROR_OK;
+}
+
 static int remote_bitbang_init(void)
 {
 	bitbang_interface = &remote_bitbang_bitbang;
@@ -323,6 +518,12 @@ static int remote_bitbang_init(void)
 
 	socket_nonblock(remote_bitbang_fd);
 
+	remote_bitbang_binary = false;
+	if (remote_bitbang_use_binary && remote_bitbang_negotiate() != ERROR_OK) {
+		close_socket(remote_bitbang_fd);
+		return ERROR_FAIL;
+	}
+
 	LOG_INFO("remote_bitbang driver initialized");
 	return ERROR_OK;
 }
@@ -349,6 +550,19 @@ COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_host_command)
 	return ERROR_COMMAND_SYNTAX_ERROR;
 }
 
+COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_binary_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], remote_bitbang_use_binary);
+
+	command_print(CMD, "remote_bitbang binary protocol %s",
+			remote_bitbang_use_binary ? "on" : "off");
+	return ERROR_OK;
+}
+
 static const struct command_registration remote_bitbang_subcommand_handlers[] = {
 	{
 		.name = "port",
@@ -366,6 +580,13 @@ static const struct command_registration remote_bitbang_subcommand_handlers[] =
 			"  if port is 0 or unset, this is the name of the unix socket to use.",
 		.usage = "host_name",
 	},
+	{
+		.name = "binary",
+		.handler = remote_bitbang_handle_remote_bitbang_binary_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Use the binary protocol for scans, if the remote end supports it.",
+		.usage = "['on'|'off']",
+	},
 	COMMAND_REGISTRATION_DONE,
 };
 
@@ -738,7 +738,7 @@ static int dtc_queue_run(void)
 				if (jtag_read_buffer(rq_p->scan.buffer,
 						rq_p->cmd->cmd.scan) != ERROR_OK)
 					retval = ERROR_JTAG_QUEUE_FAILED;
-				free(rq_p->scan.buffer);
+				jtag_free_buffer(rq_p->scan.buffer);
 			}
 
 			rq_next = rq_p->next;
@@ -1596,13 +1596,13 @@ static int ulink_queue_scan(struct ulink *device, struct jtag_command *cmd)
 		}
 
 		if (ret != ERROR_OK) {
-			free(tdi_buffer_start);
+			jtag_free_buffer(tdi_buffer_start);
 			free(tdo_buffer_start);
 			return ret;
 		}
 	}
 
-	free(tdi_buffer_start);
+	jtag_free_buffer(tdi_buffer_start);
 
 	/* Set current state to the end state requested by the command */
 	tap_set_state(cmd->cmd.scan->end_state);
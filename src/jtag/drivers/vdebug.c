@@ -10,6 +10,12 @@
  * with vdebug server and over DPI-based transactor with the emulation or simulation
  * The vdebug debug driver supports JTAG and DAP-level transports
  *
+ * Instead of the TCP socket, the client can share the vd_shm buffer with a
+ * server on the same host, mapping the same file, e.g. in /dev/shm. The state
+ * word then counts the requests of the client and the count word the replies
+ * of the server, both in host byte order. Each side waits for the word of
+ * the other with a futex on Linux and by polling elsewhere.
+ *
 */
 
 #ifdef HAVE_CONFIG_H
@@ -32,6 +38,13 @@
 #ifdef HAVE_NETDB_H
 #include <netdb.h>
 #endif
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 #endif
 #include <stdio.h>
 #ifdef HAVE_STDINT_H
@@ -61,6 +74,8 @@
 #define VD_MAX_MEMORIES 20
 #define VD_POLL_INTERVAL 500
 #define VD_SCALE_PSTOMS 1000000000
+#define VD_SHM_POLL_US 10
+#define VD_SHM_TIMEOUT_MS 60000
 
 /**
  * @brief List of transactor types
@@ -204,6 +219,9 @@ struct vd_client {
 	uint32_t poll_max;
 	uint32_t targ_time;
 	int hsocket;
+	uint32_t shm_seq;
+	uint32_t shm_timeout;
+	char shm_path[128];
 	char server_name[32];
 	char bfm_path[128];
 	char mem_path[VD_MAX_MEMORIES][128];
@@ -324,8 +342,87 @@ static int vdebug_socket_send(int hsock, struct vd_shm *pmem)
 	return rc;
 }
 
+#ifndef _WIN32
+static struct vd_shm *vdebug_shm_open(const char *path)
+{
+	int fd = open(path, O_RDWR);
+	if (fd < 0) {
+		LOG_ERROR("shm_open: cannot open %s, error %d", path, errno);
+		return NULL;
+	}
+
+	struct stat st;
+	void *pmem = MAP_FAILED;
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(struct vd_shm))
+		LOG_ERROR("shm_open: %s is smaller than %zu bytes", path, sizeof(struct vd_shm));
+	else
+		pmem = mmap(NULL, sizeof(struct vd_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (pmem == MAP_FAILED) {
+		LOG_ERROR("shm_open: cannot map %s, error %d", path, errno);
+		return NULL;
+	}
+
+	/* continue the sequence of a previous client */
+	vdc.shm_seq = __atomic_load_n((uint32_t *)((struct vd_shm *)pmem)->state, __ATOMIC_ACQUIRE);
+
+	return pmem;
+}
+
+static void vdebug_shm_close(struct vd_shm *pmem)
+{
+	munmap(pmem, sizeof(struct vd_shm));
+}
+
+/* Hand the request over to the server and wait for its reply, in place */
+static uint32_t vdebug_shm_wait_server(struct vd_shm *pmem)
+{
+	uint32_t *request = (uint32_t *)pmem->state;
+	uint32_t *reply = (uint32_t *)pmem->count;
+	uint32_t seq = ++vdc.shm_seq;
+
+	__atomic_store_n(request, seq, __ATOMIC_RELEASE);
+#ifdef __linux__
+	syscall(SYS_futex, request, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+
+	/* unlike a socket, the mapping gives no sign of a dead server */
+	int64_t deadline = timeval_ms() + vdc.shm_timeout;
+	uint32_t value;
+	while ((value = __atomic_load_n(reply, __ATOMIC_ACQUIRE)) != seq) {
+		if (timeval_ms() > deadline) {
+			LOG_ERROR("shm_wait: no reply from the server to request %" PRIu32 " in %" PRIu32 " ms",
+					  seq, vdc.shm_timeout);
+			return VD_ERR_SOC_RECV;
+		}
+#ifdef __linux__
+		struct timespec timeout = { .tv_sec = 1 };
+		if (syscall(SYS_futex, reply, FUTEX_WAIT, value, &timeout, NULL, 0) < 0 &&
+				errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT) {
+			LOG_WARNING("shm_wait: futex failed, error %d", errno);
+			return VD_ERR_SOC_RECV;
+		}
+#else
+		usleep(VD_SHM_POLL_US);
+#endif
+	}
+
+	int rc = le_to_h_u32(pmem->status);
+	LOG_DEBUG_IO("shm_wait: cmd %02" PRIx8 " done, request %" PRIu32 ", status %d",
+				 pmem->cmd, seq, rc);
+
+	return rc;
+}
+#endif
+
 static uint32_t vdebug_wait_server(int hsock, struct vd_shm *pmem)
 {
+#ifndef _WIN32
+	if (vdc.shm_path[0])
+		return vdebug_shm_wait_server(pmem);
+#endif
+
 	if (!hsock)
 		return VD_ERR_SOC_OPEN;
 
@@ -833,8 +930,49 @@ static void vdebug_mem_close(int hsock, struct vd_shm *pm, uint8_t ndx)
 }
 
 
-static int vdebug_init(void)
+static void vdebug_release(void)
+{
+#ifndef _WIN32
+	if (vdc.shm_path[0]) {
+		if (pbuf)
+			vdebug_shm_close(pbuf);
+		pbuf = NULL;
+		return;
+	}
+#endif
+
+	if (vdc.hsocket)
+		close_socket(vdc.hsocket);
+	vdc.hsocket = 0;
+	free(pbuf);
+	pbuf = NULL;
+}
+
+static const char *vdebug_server_desc(void)
 {
+	static char desc[sizeof(vdc.shm_path) + sizeof(vdc.server_name) + 8];
+
+	if (vdc.shm_path[0])
+		snprintf(desc, sizeof(desc), "%s", vdc.shm_path);
+	else
+		snprintf(desc, sizeof(desc), "%s:%" PRIu16, vdc.server_name, vdc.server_port);
+
+	return desc;
+}
+
+static int vdebug_connect(void)
+{
+#ifndef _WIN32
+	if (vdc.shm_path[0]) {
+		pbuf = vdebug_shm_open(vdc.shm_path);
+		if (!pbuf) {
+			LOG_ERROR("cannot connect to vdebug server through %s", vdc.shm_path);
+			return ERROR_FAIL;
+		}
+		return ERROR_OK;
+	}
+#endif
+
 	vdc.hsocket = vdebug_socket_open(vdc.server_name, vdc.server_port);
 	pbuf = calloc(1, sizeof(struct vd_shm));
 	if (!pbuf) {
@@ -850,6 +988,15 @@ static int vdebug_init(void)
 			vdc.server_name, vdc.server_port);
 		return ERROR_FAIL;
 	}
+
+	return ERROR_OK;
+}
+
+static int vdebug_init(void)
+{
+	if (vdebug_connect() != ERROR_OK)
+		return ERROR_FAIL;
+
 	vdc.trans_first = 1;
 	vdc.poll_cycles = vdc.poll_max;
 	uint32_t sig_mask = VD_SIG_RESET;
@@ -859,10 +1006,7 @@ static int vdebug_init(void)
 	int rc = vdebug_open(vdc.hsocket, pbuf, vdc.bfm_path, vdc.bfm_type, vdc.bfm_period, sig_mask);
 	if (rc != 0) {
 		LOG_ERROR("0x%x cannot connect to %s", rc, vdc.bfm_path);
-		close_socket(vdc.hsocket);
-		vdc.hsocket = 0;
-		free(pbuf);
-		pbuf = NULL;
+		vdebug_release();
 	} else {
 		for (uint8_t i = 0; i < vdc.mem_ndx; i++) {
 			rc = vdebug_mem_open(vdc.hsocket, pbuf, vdc.mem_path[i], i);
@@ -870,8 +1014,8 @@ static int vdebug_init(void)
 				LOG_ERROR("0x%x cannot connect to %s", rc, vdc.mem_path[i]);
 		}
 
-		LOG_INFO("vdebug %d connected to %s through %s:%" PRIu16,
-				 VD_VERSION, vdc.bfm_path, vdc.server_name, vdc.server_port);
+		LOG_INFO("vdebug %d connected to %s through %s",
+				 VD_VERSION, vdc.bfm_path, vdebug_server_desc());
 	}
 
 	return rc;
@@ -883,12 +1027,9 @@ static int vdebug_quit(void)
 		if (vdc.mem_width[i])
 			vdebug_mem_close(vdc.hsocket, pbuf, i);
 	int rc = vdebug_close(vdc.hsocket, pbuf, vdc.bfm_type);
-	LOG_INFO("vdebug %d disconnected from %s through %s:%" PRIu16 " rc:%d", VD_VERSION,
-		vdc.bfm_path, vdc.server_name, vdc.server_port, rc);
-	if (vdc.hsocket)
-		close_socket(vdc.hsocket);
-	free(pbuf);
-	pbuf = NULL;
+	LOG_INFO("vdebug %d disconnected from %s through %s rc:%d", VD_VERSION,
+		vdc.bfm_path, vdebug_server_desc(), rc);
+	vdebug_release();
 
 	return ERROR_OK;
 }
@@ -1150,6 +1291,32 @@ COMMAND_HANDLER(vdebug_set_server)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(vdebug_set_shm)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+#ifdef _WIN32
+	LOG_ERROR("shared memory transport not supported on this host");
+	return ERROR_FAIL;
+#else
+	if (strlen(CMD_ARGV[0]) >= sizeof(vdc.shm_path)) {
+		LOG_ERROR("shared memory path too long");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	vdc.shm_timeout = VD_SHM_TIMEOUT_MS;
+	if (CMD_ARGC > 1) {
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], vdc.shm_timeout);
+		if (!vdc.shm_timeout)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	strcpy(vdc.shm_path, CMD_ARGV[0]);
+	LOG_DEBUG("shm: %s timeout %" PRIu32 " ms", vdc.shm_path, vdc.shm_timeout);
+
+	return ERROR_OK;
+#endif
+}
+
 COMMAND_HANDLER(vdebug_set_bfm)
 {
 	char prefix;
@@ -1236,6 +1403,13 @@ static const struct command_registration vdebug_command_handlers[] = {
 		.help = "set the vdebug server name or address",
 		.usage = "<host:port>",
 	},
+	{
+		.name = "shm",
+		.handler = &vdebug_set_shm,
+		.mode = COMMAND_CONFIG,
+		.help = "share the vdebug buffer with a server on the same host, instead of a socket",
+		.usage = "<path> [timeout_ms]",
+	},
 	{
 		.name = "bfm_path",
 		.handler = &vdebug_set_bfm,
@@ -648,7 +648,7 @@ static int vsllink_jtag_execute(void)
 					return ERROR_JTAG_QUEUE_FAILED;
 				}
 
-				free(pending_scan_result->buffer);
+				jtag_free_buffer(pending_scan_result->buffer);
 			}
 		}
 	} else {
@@ -283,7 +283,7 @@ static int xlnx_pcie_xvc_execute_scan(struct jtag_command *cmd)
 	};
 
 	err = jtag_read_buffer(buf, cmd->cmd.scan);
-	free(buf);
+	jtag_free_buffer(buf);
 
 	if (tap_get_state() != tap_get_end_state())
 		err = xlnx_pcie_xvc_execute_statemove(1);
@@ -291,7 +291,7 @@ static int xlnx_pcie_xvc_execute_scan(struct jtag_command *cmd)
 	return err;
 
 out_err:
-	free(buf);
+	jtag_free_buffer(buf);
 	return err;
 }
 
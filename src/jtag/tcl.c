@@ -21,6 +21,7 @@
 
 #include "adapter.h"
 #include "jtag.h"
+#include "commands.h"
 #include "swd.h"
 #include "minidriver.h"
 #include "interface.h"
@@ -215,6 +216,34 @@ COMMAND_HANDLER(handle_jtag_flush_count)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_jtag_queue_stats)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		jtag_command_queue_stats_reset();
+		return ERROR_OK;
+	}
+
+	struct jtag_queue_stats last, total;
+	unsigned int flushes;
+	jtag_command_queue_stats(&last, &total, &flushes);
+
+	command_print(CMD, "last flush: %" PRIu64 " allocations of %" PRIu64 " bytes, "
+			"%" PRIu64 " new pages, %" PRIu64 " scan buffers (%" PRIu64 " not pooled)",
+			last.allocations, last.bytes, last.pages, last.scan_buffers,
+			last.scan_buffer_mallocs);
+	command_print(CMD, "%u flushes: %" PRIu64 " allocations of %" PRIu64 " bytes, "
+			"%" PRIu64 " new pages, %" PRIu64 " scan buffers (%" PRIu64 " not pooled)",
+			flushes, total.allocations, total.bytes, total.pages, total.scan_buffers,
+			total.scan_buffer_mallocs);
+
+	return ERROR_OK;
+}
+
 /* REVISIT Just what about these should "move" ... ?
  * These registrations, into the main JTAG table?
  *
@@ -716,6 +745,14 @@ COMMAND_HANDLER(handle_jtag_init_command)
 }
 
 static const struct command_registration jtag_subcommand_handlers[] = {
+	{
+		.name = "queue_stats",
+		.mode = COMMAND_EXEC,
+		.handler = handle_jtag_queue_stats,
+		.help = "Show or reset the allocations of the JTAG command "
+			"queue, for the last flush and in total.",
+		.usage = "['reset']",
+	},
 	{
 		.name = "init",
 		.mode = COMMAND_ANY,
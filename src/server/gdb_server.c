@@ -27,6 +27,7 @@
 #include "config.h"
 #endif
 
+#include <helper/align.h>
 #include <target/breakpoints.h>
 #include <target/target_request.h>
 #include <target/register.h>
@@ -57,9 +58,79 @@ enum gdb_output_flag {
 	GDB_OUTPUT_ALL,
 };
 
-struct target_desc_format {
+/* target description of a target, kept until its registers change */
+struct gdb_tdesc_cache {
+	struct target *target;
+	/* register_cache_generation() when the description was generated */
+	unsigned int generation;
+	/* architecture and register list described, both can change with the
+	 * state of the core, e.g. AArch32 and AArch64 on ARMv8 */
+	char *architecture;
+	uint32_t reg_signature;
 	char *tdesc;
 	uint32_t tdesc_length;
+	struct list_head lh;
+};
+
+/* size of the buffer collecting replies before they are written */
+#define GDB_OUT_BUFFER_SIZE 4096
+
+/* buffer reused across packets of a connection, grown on demand */
+struct gdb_scratch {
+	void *buf;
+	size_t size;
+};
+
+/* minimum size of the chunks of whole sectors programmed while streaming */
+#define GDB_FLASH_CHUNK_SIZE (64 * 1024)
+
+/* flash sectors collecting the data of vFlashWrite packets */
+struct gdb_flash_chunk {
+	/* no chunk if size is 0 */
+	target_addr_t address;
+	uint32_t size;
+	/* data received, relative to address */
+	uint32_t begin;
+	uint32_t end;
+	struct gdb_scratch data;
+};
+
+/* flash sectors given to the chunks */
+struct gdb_flash_range {
+	target_addr_t start;
+	target_addr_t end;
+};
+
+/* vFlashWrite data programmed while GDB is still sending it */
+struct gdb_flash_stream {
+	/* one chunk receives the data while the other one is programmed */
+	struct gdb_flash_chunk chunk[2];
+	unsigned int filling;
+	bool pending;
+	/* chunks below this address are already handled */
+	target_addr_t next;
+	/* sorted ranges of the sectors of all the chunks, merged when adjacent */
+	struct gdb_flash_range *ranges;
+	unsigned int num_ranges;
+	unsigned int max_ranges;
+	bool started;
+	/* first error, reported to the following packets */
+	int error;
+	uint32_t written;
+};
+
+/* limits of the memory read ahead for the received 'm' and 'x' packets */
+#define GDB_PREFETCH_MAX_SPANS 8
+#define GDB_PREFETCH_MAX_SIZE (64 * 1024)
+
+/* contiguous target memory requested by several pending packets */
+struct gdb_prefetch_span {
+	uint64_t addr;
+	uint32_t len;
+	/* number of packets requesting memory in the span */
+	unsigned int requests;
+	/* position of the data in the prefetch scratch buffer */
+	size_t offset;
 };
 
 /* private connection data for GDB */
@@ -70,6 +141,7 @@ struct gdb_connection {
 	bool ctrl_c;
 	enum target_state frontend_state;
 	struct image *vflash_image;
+	struct gdb_flash_stream flash_stream;
 	bool closed;
 	bool busy;
 	int noack_mode;
@@ -89,12 +161,24 @@ struct gdb_connection {
 	bool attached;
 	/* set when extended protocol is used */
 	bool extended_protocol;
-	/* temporarily used for target description support */
-	struct target_desc_format target_desc;
 	/* temporarily used for thread list support */
 	char *thread_list;
 	/* flag to mask the output from gdb_log_callback() */
 	enum gdb_output_flag output_flag;
+	/* target memory read by 'm' and 'x' packets */
+	struct gdb_scratch mem_scratch;
+	/* framed reply of 'm' and 'x' packets */
+	struct gdb_scratch reply_scratch;
+	/* memory read ahead for pending 'm' and 'x' packets, see gdb_prefetch_memory() */
+	struct gdb_scratch prefetch_scratch;
+	struct gdb_prefetch_span prefetch[GDB_PREFETCH_MAX_SPANS];
+	unsigned int prefetch_spans;
+	bool prefetch_done;
+	/* output not yet written to the socket, see gdb_flush() */
+	char out_buf[GDB_OUT_BUFFER_SIZE];
+	int out_len;
+	/* set while received packets are processed, to coalesce the replies */
+	bool out_defer;
 };
 
 #if 0
@@ -107,9 +191,12 @@ static int gdb_breakpoint_override;
 static enum breakpoint_type gdb_breakpoint_override_type;
 
 static int gdb_error(struct connection *connection, int retval);
+static int gdb_flush(struct connection *connection);
 static char *gdb_port;
 static char *gdb_port_next;
 
+static LIST_HEAD(gdb_tdesc_caches);
+
 static void gdb_log_callback(void *priv, const char *file, unsigned line,
 		const char *function, const char *string);
 
@@ -125,6 +212,8 @@ static int gdb_actual_connections;
 static int gdb_use_memory_map = 1;
 /* enabled by default*/
 static int gdb_flash_program = 1;
+/* program the flash while vFlashWrite packets are received, disabled by default */
+static int gdb_flash_stream;
 
 /* if set, data aborts cause an error to be reported in memory read packets
  * see the code in gdb_read_memory_packet() for further explanations.
@@ -210,6 +299,11 @@ static int gdb_get_char_inner(struct connection *connection, int *next_char)
 #ifdef _DEBUG_GDB_IO_
 	char *debug_buffer;
 #endif
+	/* the reply GDB may be waiting for must not sit in the output buffer */
+	retval = gdb_flush(connection);
+	if (retval != ERROR_OK)
+		return retval;
+
 	for (;; ) {
 		if (connection->service->type != CONNECTION_TCP)
 			gdb_con->buf_cnt = read(connection->fd, gdb_con->buffer, GDB_BUFFER_SIZE);
@@ -341,18 +435,39 @@ static int gdb_putback_char(struct connection *connection, int last_char)
 	return ERROR_OK;
 }
 
-/* The only way we can detect that the socket is closed is the first time
+/* Write the pending output followed by the given buffers with a single
+ * system call.
+ *
+ * The only way we can detect that the socket is closed is the first time
  * we write to it, we will fail. Subsequent write operations will
  * succeed. Shudder! */
-static int gdb_write(struct connection *connection, void *data, int len)
+static int gdb_writev(struct connection *connection, struct iovec *iov, int iovcnt)
 {
 	struct gdb_connection *gdb_con = connection->priv;
+	struct iovec vec[4];
+	int cnt = 0;
+	int len = 0;
+
+	assert(iovcnt < (int)ARRAY_SIZE(vec));
+
 	if (gdb_con->closed) {
 		LOG_DEBUG("GDB socket marked as closed, cannot write to it.");
+		gdb_con->out_len = 0;
 		return ERROR_SERVER_REMOTE_CLOSED;
 	}
 
-	if (connection_write(connection, data, len) == len)
+	if (gdb_con->out_len) {
+		vec[cnt].iov_base = gdb_con->out_buf;
+		vec[cnt++].iov_len = gdb_con->out_len;
+		len += gdb_con->out_len;
+		gdb_con->out_len = 0;
+	}
+	for (int i = 0; i < iovcnt; i++) {
+		vec[cnt++] = iov[i];
+		len += iov[i].iov_len;
+	}
+
+	if (connection_writev(connection, vec, cnt) == len)
 		return ERROR_OK;
 
 	LOG_WARNING("Error writing to GDB socket. Dropping the connection.");
@@ -360,6 +475,46 @@ static int gdb_write(struct connection *connection, void *data, int len)
 	return ERROR_SERVER_REMOTE_CLOSED;
 }
 
+static int gdb_write(struct connection *connection, void *data, int len)
+{
+	struct iovec iov = {
+		.iov_base = data,
+		.iov_len = len,
+	};
+
+	return gdb_writev(connection, &iov, 1);
+}
+
+/* write the output collected while replies are deferred */
+static int gdb_flush(struct connection *connection)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+
+	if (!gdb_con->out_len)
+		return ERROR_OK;
+
+	return gdb_writev(connection, NULL, 0);
+}
+
+/* Queue data for output. It is written immediately unless replies are
+ * deferred; when it does not fit in the output buffer it is written
+ * together with the pending output. */
+static int gdb_write_deferred(struct connection *connection, const void *data, int len)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+
+	if (gdb_con->out_len + len > GDB_OUT_BUFFER_SIZE)
+		return gdb_write(connection, (void *)data, len);
+
+	memcpy(gdb_con->out_buf + gdb_con->out_len, data, len);
+	gdb_con->out_len += len;
+
+	if (gdb_con->out_defer)
+		return ERROR_OK;
+
+	return gdb_flush(connection);
+}
+
 static void gdb_log_incoming_packet(struct connection *connection, char *packet)
 {
 	if (!LOG_LEVEL_IS(LOG_LVL_DEBUG))
@@ -407,18 +562,52 @@ static void gdb_log_outgoing_packet(struct connection *connection, char *packet_
 			checksum);
 }
 
+static void *gdb_scratch_get(struct gdb_scratch *scratch, size_t size)
+{
+	if (size > scratch->size) {
+		void *buf = realloc(scratch->buf, size);
+		if (!buf)
+			return NULL;
+		scratch->buf = buf;
+		scratch->size = size;
+	}
+
+	return scratch->buf;
+}
+
+static void gdb_scratch_free(struct gdb_scratch *scratch)
+{
+	free(scratch->buf);
+	scratch->buf = NULL;
+	scratch->size = 0;
+}
+
+static unsigned char gdb_checksum(const char *buffer, int len)
+{
+	unsigned char checksum = 0;
+
+	for (int i = 0; i < len; i++)
+		checksum += buffer[i];
+
+	return checksum;
+}
+
+/*
+ * Send a packet. If 'framed' is set, the caller reserved one byte in front
+ * of the payload for '$' and four bytes after it for "#xx" and its
+ * terminator, so the whole packet is a single contiguous buffer.
+ *
+ * In no-ack mode, the packet is only queued while gdb_input() processes the
+ * packets received from GDB, so that consecutive replies are written
+ * together when it is done.
+ */
 static int gdb_put_packet_inner(struct connection *connection,
-		char *buffer, int len)
+		char *buffer, int len, unsigned char my_checksum, bool framed)
 {
-	int i;
-	unsigned char my_checksum = 0;
 	int reply;
 	int retval;
 	struct gdb_connection *gdb_con = connection->priv;
 
-	for (i = 0; i < len; i++)
-		my_checksum += buffer[i];
-
 #ifdef _DEBUG_GDB_IO_
 	/*
 	 * At this point we should have nothing in the input queue from GDB,
@@ -449,29 +638,37 @@ static int gdb_put_packet_inner(struct connection *connection,
 	while (1) {
 		gdb_log_outgoing_packet(connection, buffer, len, my_checksum);
 
-		char local_buffer[1024];
-		local_buffer[0] = '$';
-		if ((size_t)len + 4 <= sizeof(local_buffer)) {
-			/* performance gain on smaller packets by only a single call to gdb_write() */
-			memcpy(local_buffer + 1, buffer, len++);
-			len += snprintf(local_buffer + len, sizeof(local_buffer) - len, "#%02x", my_checksum);
-			retval = gdb_write(connection, local_buffer, len);
-			if (retval != ERROR_OK)
-				return retval;
+		char trailer[4];
+		snprintf(trailer, sizeof(trailer), "#%02x", my_checksum);
+
+		if (gdb_con->out_len + len + 4 <= GDB_OUT_BUFFER_SIZE) {
+			/* small packets are collected in the output buffer */
+			char *p = gdb_con->out_buf + gdb_con->out_len;
+			*p++ = '$';
+			memcpy(p, buffer, len);
+			memcpy(p + len, trailer, 3);
+			gdb_con->out_len += len + 4;
+
+			if (gdb_con->noack_mode && gdb_con->out_defer)
+				break;
+
+			retval = gdb_flush(connection);
+		} else if (framed) {
+			buffer[-1] = '$';
+			memcpy(buffer + len, trailer, 3);
+			retval = gdb_write(connection, buffer - 1, len + 4);
 		} else {
-			/* larger packets are transmitted directly from caller supplied buffer
-			 * by several calls to gdb_write() to avoid dynamic allocation */
-			snprintf(local_buffer + 1, sizeof(local_buffer) - 1, "#%02x", my_checksum);
-			retval = gdb_write(connection, local_buffer, 1);
-			if (retval != ERROR_OK)
-				return retval;
-			retval = gdb_write(connection, buffer, len);
-			if (retval != ERROR_OK)
-				return retval;
-			retval = gdb_write(connection, local_buffer + 1, 3);
-			if (retval != ERROR_OK)
-				return retval;
+			/* larger packets are transmitted directly from caller supplied buffer,
+			 * together with the pending output, to avoid dynamic allocation */
+			struct iovec iov[3] = {
+				{ .iov_base = "$", .iov_len = 1 },
+				{ .iov_base = buffer, .iov_len = len },
+				{ .iov_base = trailer, .iov_len = 3 },
+			};
+			retval = gdb_writev(connection, iov, ARRAY_SIZE(iov));
 		}
+		if (retval != ERROR_OK)
+			return retval;
 
 		if (gdb_con->noack_mode)
 			break;
@@ -528,11 +725,12 @@ static int gdb_put_packet_inner(struct connection *connection,
 	return ERROR_OK;
 }
 
-int gdb_put_packet(struct connection *connection, char *buffer, int len)
+static int gdb_put_packet_checksum(struct connection *connection,
+		char *buffer, int len, unsigned char checksum, bool framed)
 {
 	struct gdb_connection *gdb_con = connection->priv;
 	gdb_con->busy = true;
-	int retval = gdb_put_packet_inner(connection, buffer, len);
+	int retval = gdb_put_packet_inner(connection, buffer, len, checksum, framed);
 	gdb_con->busy = false;
 
 	/* we sent some data, reset timer for keep alive messages */
@@ -541,6 +739,12 @@ int gdb_put_packet(struct connection *connection, char *buffer, int len)
 	return retval;
 }
 
+int gdb_put_packet(struct connection *connection, char *buffer, int len)
+{
+	return gdb_put_packet_checksum(connection, buffer, len,
+			gdb_checksum(buffer, len), false);
+}
+
 static inline int fetch_packet(struct connection *connection,
 		int *checksum_ok, int noack, int *len, char *buffer)
 {
@@ -727,7 +931,8 @@ static int gdb_get_packet_inner(struct connection *connection,
 			break;
 		}
 		if (checksum_ok) {
-			retval = gdb_write(connection, "+", 1);
+			/* the reply, if any, follows shortly: send the ack along */
+			retval = gdb_write_deferred(connection, "+", 1);
 			if (retval != ERROR_OK)
 				return retval;
 			break;
@@ -996,6 +1201,7 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->ctrl_c = false;
 	gdb_connection->frontend_state = TARGET_HALTED;
 	gdb_connection->vflash_image = NULL;
+	memset(&gdb_connection->flash_stream, 0, sizeof(gdb_connection->flash_stream));
 	gdb_connection->closed = false;
 	gdb_connection->busy = false;
 	gdb_connection->noack_mode = 0;
@@ -1003,10 +1209,18 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->mem_write_error = false;
 	gdb_connection->attached = true;
 	gdb_connection->extended_protocol = false;
-	gdb_connection->target_desc.tdesc = NULL;
-	gdb_connection->target_desc.tdesc_length = 0;
 	gdb_connection->thread_list = NULL;
 	gdb_connection->output_flag = GDB_OUTPUT_NO;
+	gdb_connection->mem_scratch.buf = NULL;
+	gdb_connection->mem_scratch.size = 0;
+	gdb_connection->reply_scratch.buf = NULL;
+	gdb_connection->reply_scratch.size = 0;
+	gdb_connection->prefetch_scratch.buf = NULL;
+	gdb_connection->prefetch_scratch.size = 0;
+	gdb_connection->prefetch_spans = 0;
+	gdb_connection->prefetch_done = false;
+	gdb_connection->out_len = 0;
+	gdb_connection->out_defer = false;
 
 	/* send ACK to GDB for debug request */
 	gdb_write(connection, "+", 1);
@@ -1120,10 +1334,17 @@ static int gdb_connection_closed(struct connection *connection)
 		free(gdb_connection->vflash_image);
 		gdb_connection->vflash_image = NULL;
 	}
+	gdb_scratch_free(&gdb_connection->flash_stream.chunk[0].data);
+	gdb_scratch_free(&gdb_connection->flash_stream.chunk[1].data);
+	free(gdb_connection->flash_stream.ranges);
 
 	/* if this connection registered a debug-message receiver delete it */
 	delete_debug_msg_receiver(connection->cmd_ctx, target);
 
+	gdb_scratch_free(&gdb_connection->mem_scratch);
+	gdb_scratch_free(&gdb_connection->reply_scratch);
+	gdb_scratch_free(&gdb_connection->prefetch_scratch);
+
 	free(connection->priv);
 	connection->priv = NULL;
 
@@ -1485,19 +1706,199 @@ static int gdb_error(struct connection *connection, int retval)
 	return ERROR_OK;
 }
 
+/* Escape binary data of a reply, see "Binary Data" in the GDB manual.
+ * 'out' must have room for 2 * len bytes. Returns the escaped length and
+ * adds the escaped bytes to 'checksum'. */
+static size_t gdb_escape_binary(char *out, const uint8_t *in, size_t len,
+		unsigned char *checksum)
+{
+	unsigned char sum = *checksum;
+	char *p = out;
+
+	for (size_t i = 0; i < len; i++) {
+		uint8_t c = in[i];
+		/* '*' would start a run-length encoding in a reply */
+		if (c == '#' || c == '$' || c == '}' || c == '*') {
+			*p++ = '}';
+			sum += '}';
+			c ^= 0x20;
+		}
+		*p++ = c;
+		sum += c;
+	}
+
+	*checksum = sum;
+	return p - out;
+}
+
+/* add [addr, addr + len) to the span it touches, or to a new span */
+static bool gdb_prefetch_add(struct gdb_prefetch_span *spans,
+		unsigned int *num_spans, uint64_t addr, uint32_t len)
+{
+	uint64_t end = addr + len;
+
+	for (unsigned int i = 0; i < *num_spans; i++) {
+		struct gdb_prefetch_span *span = &spans[i];
+		if (addr > span->addr + span->len || end < span->addr)
+			continue;
+
+		uint64_t span_addr = MIN(span->addr, addr);
+		uint64_t span_end = MAX(span->addr + span->len, end);
+		if (span_end - span_addr > GDB_PREFETCH_MAX_SIZE)
+			continue;
+
+		span->addr = span_addr;
+		span->len = span_end - span_addr;
+		span->requests++;
+		return true;
+	}
+
+	if (*num_spans == GDB_PREFETCH_MAX_SPANS)
+		return false;
+
+	spans[*num_spans].addr = addr;
+	spans[*num_spans].len = len;
+	spans[*num_spans].requests = 1;
+	(*num_spans)++;
+	return true;
+}
+
+/**
+ * In no-ack mode GDB sends its memory reads back to back, e.g. for a
+ * backtrace. Look ahead in the input buffer for the complete 'm' and 'x'
+ * packets that follow, up to the first packet that could change the target
+ * memory, and read the memory requested by several contiguous or
+ * overlapping packets in a single target access. The replies are then
+ * built from this data, still one packet at a time and in order.
+ *
+ * Only the requested memory is read. A failed read is just not used, so
+ * that the packets report the errors as if they were handled one by one.
+ */
+static void gdb_prefetch_memory(struct connection *connection)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	struct target *target = get_target_from_connection(connection);
+	struct gdb_prefetch_span spans[GDB_PREFETCH_MAX_SPANS];
+	unsigned int num_spans = 0;
+	const char *p = gdb_con->buf_p;
+	const char *end = p + gdb_con->buf_cnt;
+
+	gdb_con->prefetch_done = true;
+	gdb_con->prefetch_spans = 0;
+
+	/* rtos_read_buffer() can redirect the reads */
+	if (!gdb_con->noack_mode || target->rtos || target->state != TARGET_HALTED)
+		return;
+
+	while (p < end) {
+		if (*p == '+') {
+			p++;
+			continue;
+		}
+		if (*p != '$')
+			break;
+
+		const char *hash = memchr(p, '#', end - p);
+		if (!hash || end - hash < 3)
+			break;
+
+		const char *packet = p + 1;
+		p = hash + 3;
+
+		/* reading registers does not change the memory */
+		if (packet[0] == 'g' || packet[0] == 'p')
+			continue;
+		if (packet[0] != 'm' && packet[0] != 'x')
+			break;
+
+		/* the hex numbers end at the latest on '#' */
+		char *separator;
+		uint64_t addr = strtoull(packet + 1, &separator, 16);
+		if (*separator != ',')
+			break;
+		uint32_t len = strtoul(separator + 1, &separator, 16);
+		if (separator != hash || !len || len > GDB_PREFETCH_MAX_SIZE ||
+				addr + len < addr)
+			break;
+
+		if (!gdb_prefetch_add(spans, &num_spans, addr, len))
+			break;
+	}
+
+	/* memory requested by a single packet is read when the packet is handled */
+	size_t size = 0;
+	for (unsigned int i = 0; i < num_spans; i++) {
+		if (spans[i].requests < 2)
+			continue;
+		spans[i].offset = size;
+		size += spans[i].len;
+		gdb_con->prefetch[gdb_con->prefetch_spans++] = spans[i];
+	}
+
+	if (!size)
+		return;
+
+	uint8_t *data = gdb_scratch_get(&gdb_con->prefetch_scratch, size);
+	if (!data) {
+		gdb_con->prefetch_spans = 0;
+		return;
+	}
+
+	unsigned int valid = 0;
+	for (unsigned int i = 0; i < gdb_con->prefetch_spans; i++) {
+		struct gdb_prefetch_span *span = &gdb_con->prefetch[i];
+
+		LOG_DEBUG("prefetch addr: 0x%16.16" PRIx64 ", len: 0x%8.8" PRIx32
+				" for %u packets", span->addr, span->len, span->requests);
+		if (target_read_buffer(target, span->addr, span->len, data + span->offset) != ERROR_OK)
+			continue;
+		gdb_con->prefetch[valid++] = *span;
+	}
+	gdb_con->prefetch_spans = valid;
+}
+
+static void gdb_prefetch_drop(struct gdb_connection *gdb_con)
+{
+	gdb_con->prefetch_spans = 0;
+	gdb_con->prefetch_done = false;
+}
+
+/* @returns true if the memory requested by a packet was read ahead */
+static bool gdb_prefetched_memory(struct gdb_connection *gdb_con,
+		uint64_t addr, uint32_t len, uint8_t *buffer)
+{
+	for (unsigned int i = 0; i < gdb_con->prefetch_spans; i++) {
+		struct gdb_prefetch_span *span = &gdb_con->prefetch[i];
+		if (addr < span->addr || addr + len > span->addr + span->len)
+			continue;
+
+		uint8_t *data = gdb_con->prefetch_scratch.buf;
+		memcpy(buffer, data + span->offset + (addr - span->addr), len);
+		return true;
+	}
+
+	return false;
+}
+
 /* We don't have to worry about the default 2 second timeout for GDB packets,
  * because GDB breaks up large memory reads into smaller reads.
+ *
+ * Handles both 'm' (hex encoded reply) and 'x' (binary reply) packets. The
+ * reply is built in a per-connection buffer with room for the packet framing,
+ * so that it is sent without further copies.
  */
 static int gdb_read_memory_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
 	struct target *target = get_target_from_connection(connection);
+	struct gdb_connection *gdb_con = connection->priv;
+	bool binary = packet[0] == 'x';
 	char *separator;
 	uint64_t addr = 0;
 	uint32_t len = 0;
 
 	uint8_t *buffer;
-	char *hex_buffer;
+	char *reply;
 
 	int retval = ERROR_OK;
 
@@ -1514,17 +1915,29 @@ static int gdb_read_memory_packet(struct connection *connection,
 	len = strtoul(separator + 1, NULL, 16);
 
 	if (!len) {
+		if (binary) {
+			gdb_put_packet(connection, "b", 1);
+			return ERROR_OK;
+		}
 		LOG_WARNING("invalid read memory packet received (len == 0)");
 		gdb_put_packet(connection, "", 0);
 		return ERROR_OK;
 	}
 
-	buffer = malloc(len);
+	buffer = gdb_scratch_get(&gdb_con->mem_scratch, len);
+	/* '$', 'b', payload escaped or hex encoded, "#xx" and terminator */
+	reply = gdb_scratch_get(&gdb_con->reply_scratch, 2 + 2 * (size_t)len + 4);
+	if (!buffer || !reply) {
+		LOG_ERROR("Unable to allocate %" PRIu32 " bytes for memory read", len);
+		return gdb_error(connection, ERROR_FAIL);
+	}
 
 	LOG_DEBUG("addr: 0x%16.16" PRIx64 ", len: 0x%8.8" PRIx32 "", addr, len);
 
 	retval = ERROR_NOT_IMPLEMENTED;
-	if (target->rtos)
+	if (gdb_prefetched_memory(gdb_con, addr, len, buffer))
+		retval = ERROR_OK;
+	else if (target->rtos)
 		retval = rtos_read_buffer(target, addr, len, buffer);
 	if (retval == ERROR_NOT_IMPLEMENTED)
 		retval = target_read_buffer(target, addr, len, buffer);
@@ -1547,20 +1960,23 @@ static int gdb_read_memory_packet(struct connection *connection,
 		retval = ERROR_OK;
 	}
 
-	if (retval == ERROR_OK) {
-		hex_buffer = malloc(len * 2 + 1);
-
-		size_t pkt_len = hexify(hex_buffer, buffer, len, len * 2 + 1);
-
-		gdb_put_packet(connection, hex_buffer, pkt_len);
-
-		free(hex_buffer);
-	} else
-		retval = gdb_error(connection, retval);
+	if (retval != ERROR_OK)
+		return gdb_error(connection, retval);
 
-	free(buffer);
+	/* reply[0] is left for '$' */
+	char *payload = reply + 1;
+	size_t pkt_len;
+	unsigned char checksum;
+	if (binary) {
+		payload[0] = 'b';
+		checksum = 'b';
+		pkt_len = 1 + gdb_escape_binary(payload + 1, buffer, len, &checksum);
+	} else {
+		pkt_len = hexify(payload, buffer, len, len * 2 + 1);
+		checksum = gdb_checksum(payload, pkt_len);
+	}
 
-	return retval;
+	return gdb_put_packet_checksum(connection, payload, pkt_len, checksum, true);
 }
 
 static int gdb_write_memory_packet(struct connection *connection,
@@ -1824,34 +2240,41 @@ static __attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 5, 6))) void xml_printf(
 {
 	if (*retval != ERROR_OK)
 		return;
-	int first = 1;
 
+	int ret = 0;
 	for (;; ) {
-		if ((!*xml) || (!first)) {
-			/* start by 0 to exercise all the code paths.
-			 * Need minimum 2 bytes to fit 1 char and 0 terminator. */
-
-			*size = *size * 2 + 2;
-			char *t = *xml;
-			*xml = realloc(*xml, *size);
-			if (!*xml) {
-				free(t);
-				*retval = ERROR_SERVER_REMOTE_CLOSED;
+		if (*xml) {
+			va_list ap;
+			va_start(ap, fmt);
+			ret = vsnprintf(*xml + *pos, *size - *pos, fmt, ap);
+			va_end(ap);
+			if (ret < 0) {
+				*retval = ERROR_FAIL;
+				return;
+			}
+			if (ret < *size - *pos) {
+				*pos += ret;
 				return;
 			}
 		}
 
-		va_list ap;
-		int ret;
-		va_start(ap, fmt);
-		ret = vsnprintf(*xml + *pos, *size - *pos, fmt, ap);
-		va_end(ap);
-		if ((ret > 0) && ((ret + 1) < *size - *pos)) {
-			*pos += ret;
+		/* Not enough space. Grow geometrically and to the size now known
+		 * to be needed, so that large documents take few reallocations. */
+		int new_size = MAX(*size, 1024);
+		while (new_size <= *pos + ret)
+			new_size *= 2;
+		if (new_size == *size)
+			new_size *= 2;
+
+		char *t = realloc(*xml, new_size);
+		if (!t) {
+			free(*xml);
+			*xml = NULL;
+			*retval = ERROR_SERVER_REMOTE_CLOSED;
 			return;
 		}
-		/* there was just enough or not enough space, allocate more. */
-		first = 0;
+		*xml = t;
+		*size = new_size;
 	}
 }
 
@@ -2543,33 +2966,145 @@ error:
 	return retval;
 }
 
-static int gdb_get_target_description_chunk(struct target *target, struct target_desc_format *target_desc,
-		char **chunk, int32_t offset, uint32_t length)
+/* add the registers GDB is told about, their size and existence, to the
+ * FNV-1a hash */
+static int gdb_reg_list_hash(struct target *target, uint32_t *hash)
 {
-	if (!target_desc) {
-		LOG_ERROR("Unable to Generate Target Description");
-		return ERROR_FAIL;
+	struct reg **reg_list;
+	int reg_list_size;
+
+	int retval = target_get_gdb_reg_list_noread(target, &reg_list, &reg_list_size,
+			REG_CLASS_ALL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (int i = 0; i < reg_list_size; i++) {
+		uint32_t values[] = {
+			(uint32_t)(uintptr_t)reg_list[i], reg_list[i]->size, reg_list[i]->exist
+		};
+		for (unsigned int j = 0; j < ARRAY_SIZE(values); j++) {
+			*hash ^= values[j];
+			*hash *= 16777619u;
+		}
 	}
+	free(reg_list);
 
-	char *tdesc = target_desc->tdesc;
-	uint32_t tdesc_length = target_desc->tdesc_length;
+	return ERROR_OK;
+}
 
-	if (!tdesc) {
-		int retval = gdb_generate_target_description(target, &tdesc);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Unable to Generate Target Description");
-			return ERROR_FAIL;
+static int gdb_reg_list_signature(struct target *target, uint32_t *signature)
+{
+	uint32_t hash = 2166136261u;
+
+	if (!target->smp) {
+		int retval = gdb_reg_list_hash(target, &hash);
+		if (retval != ERROR_OK)
+			return retval;
+	} else {
+		struct target_list *head;
+		foreach_smp_target(head, target->smp_targets) {
+			if (!target_was_examined(head->target))
+				continue;
+			int retval = gdb_reg_list_hash(head->target, &hash);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+	}
+
+	*signature = hash;
+	return ERROR_OK;
+}
+
+/* Get the target description of target, generating it only if the registers
+ * changed since it was last generated. With refresh false, the description
+ * is not regenerated, e.g. in the middle of a qXfer transfer. */
+static struct gdb_tdesc_cache *gdb_get_target_description(struct target *target, bool refresh)
+{
+	struct gdb_tdesc_cache *cache;
+	bool found = false;
+
+	list_for_each_entry(cache, &gdb_tdesc_caches, lh) {
+		if (cache->target == target) {
+			found = true;
+			break;
+		}
+	}
+
+	if (!found) {
+		cache = calloc(1, sizeof(*cache));
+		if (!cache) {
+			LOG_ERROR("Unable to allocate memory");
+			return NULL;
 		}
+		cache->target = target;
+		list_add_tail(&cache->lh, &gdb_tdesc_caches);
+	}
+
+	if (cache->tdesc && !refresh)
+		return cache;
+
+	unsigned int generation = register_cache_generation();
+	const char *architecture = target_get_gdb_arch(target);
+	uint32_t reg_signature;
+	bool valid = cache->tdesc && cache->generation == generation &&
+		gdb_reg_list_signature(target, &reg_signature) == ERROR_OK &&
+		cache->reg_signature == reg_signature;
+	if (valid && (architecture || cache->architecture))
+		valid = architecture && cache->architecture &&
+			!strcmp(architecture, cache->architecture);
+	if (valid)
+		return cache;
 
-		tdesc_length = strlen(tdesc);
+	char *tdesc;
+	if (gdb_generate_target_description(target, &tdesc) != ERROR_OK) {
+		LOG_ERROR("Unable to Generate Target Description");
+		return NULL;
 	}
 
+	free(cache->tdesc);
+	cache->tdesc = tdesc;
+	cache->tdesc_length = strlen(tdesc);
+	cache->generation = generation;
+	free(cache->architecture);
+	cache->architecture = architecture ? strdup(architecture) : NULL;
+	/* without a signature, generate it again next time */
+	if (gdb_reg_list_signature(target, &cache->reg_signature) != ERROR_OK)
+		cache->generation = generation - 1;
+	LOG_DEBUG("generated target description of %s, %" PRIu32 " bytes",
+			target_name(target), cache->tdesc_length);
+
+	return cache;
+}
+
+static void gdb_free_target_descriptions(void)
+{
+	struct gdb_tdesc_cache *cache, *tmp;
+
+	list_for_each_entry_safe(cache, tmp, &gdb_tdesc_caches, lh) {
+		list_del(&cache->lh);
+		free(cache->architecture);
+		free(cache->tdesc);
+		free(cache);
+	}
+}
+
+static int gdb_get_target_description_chunk(struct target *target,
+		char **chunk, uint32_t offset, uint32_t length)
+{
+	/* GDB reads the description from offset 0 on every connection */
+	struct gdb_tdesc_cache *cache = gdb_get_target_description(target, offset == 0);
+	if (!cache)
+		return ERROR_FAIL;
+
+	uint32_t left = offset < cache->tdesc_length ? cache->tdesc_length - offset : 0;
 	char transfer_type;
 
-	if (length < (tdesc_length - offset))
+	if (length < left) {
 		transfer_type = 'm';
-	else
+	} else {
 		transfer_type = 'l';
+		length = left;
+	}
 
 	*chunk = malloc(length + 2);
 	if (!*chunk) {
@@ -2578,21 +3113,8 @@ static int gdb_get_target_description_chunk(struct target *target, struct target
 	}
 
 	(*chunk)[0] = transfer_type;
-	if (transfer_type == 'm') {
-		strncpy((*chunk) + 1, tdesc + offset, length);
-		(*chunk)[1 + length] = '\0';
-	} else {
-		strncpy((*chunk) + 1, tdesc + offset, tdesc_length - offset);
-		(*chunk)[1 + (tdesc_length - offset)] = '\0';
-
-		/* After gdb-server sends out last chunk, invalidate tdesc. */
-		free(tdesc);
-		tdesc = NULL;
-		tdesc_length = 0;
-	}
-
-	target_desc->tdesc = tdesc;
-	target_desc->tdesc_length = tdesc_length;
+	memcpy((*chunk) + 1, cache->tdesc + offset, length);
+	(*chunk)[1 + length] = '\0';
 
 	return ERROR_OK;
 }
@@ -2883,7 +3405,7 @@ static int gdb_query_packet(struct connection *connection,
 			&buffer,
 			&pos,
 			&size,
-			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;qXfer:threads:read+;QStartNoAckMode+;vContSupported+",
+			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;qXfer:threads:read+;QStartNoAckMode+;vContSupported+;binary-upload+",
 			GDB_BUFFER_SIZE,
 			((gdb_use_memory_map == 1) && (flash_get_bank_count() > 0)) ? '+' : '-',
 			(gdb_target_desc_supported == 1) ? '+' : '-');
@@ -2920,8 +3442,7 @@ static int gdb_query_packet(struct connection *connection,
 		 * there are *more* chunks to transfer. 'l' for it is the *last*
 		 * chunk of target description.
 		 */
-		retval = gdb_get_target_description_chunk(target, &gdb_connection->target_desc,
-				&xml, offset, length);
+		retval = gdb_get_target_description_chunk(target, &xml, offset, length);
 		if (retval != ERROR_OK) {
 			gdb_error(connection, retval);
 			return retval;
@@ -3243,6 +3764,302 @@ static bool gdb_handle_vrun_packet(struct connection *connection, const char *pa
 	return true;
 }
 
+static void gdb_flash_error(struct connection *connection, int retval)
+{
+	if (retval == ERROR_FLASH_DST_OUT_OF_BANK)
+		gdb_put_packet(connection, "E.memtype", 9);
+	else
+		gdb_send_error(connection, EIO);
+}
+
+/* add data to the image programmed at vFlashDone */
+static int gdb_vflash_image_add(struct connection *connection,
+		target_addr_t addr, uint32_t length, const uint8_t *data)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+
+	/* create a new image if there isn't already one */
+	if (!gdb_connection->vflash_image) {
+		gdb_connection->vflash_image = malloc(sizeof(struct image));
+		image_open(gdb_connection->vflash_image, "", "build");
+	}
+
+	/* create new section with content from packet buffer */
+	return image_add_section(gdb_connection->vflash_image,
+			addr, length, 0x0, data);
+}
+
+static void gdb_flash_stream_start(struct connection *connection)
+{
+	struct gdb_connection *gdb_connection = connection->priv;
+
+	if (gdb_connection->flash_stream.started)
+		return;
+
+	gdb_connection->flash_stream.started = true;
+	target_call_event_callbacks(get_target_from_connection(connection),
+			TARGET_EVENT_GDB_FLASH_WRITE_START);
+}
+
+static void gdb_flash_stream_reset(struct gdb_flash_stream *stream)
+{
+	stream->chunk[0].size = 0;
+	stream->chunk[1].size = 0;
+	stream->filling = 0;
+	stream->pending = false;
+	stream->next = 0;
+	stream->num_ranges = 0;
+	stream->started = false;
+	stream->error = ERROR_OK;
+	stream->written = 0;
+}
+
+/* program the data received in a chunk, errors are kept for the next packets */
+static void gdb_flash_chunk_program(struct connection *connection,
+		struct gdb_flash_chunk *chunk)
+{
+	struct gdb_flash_stream *stream = &((struct gdb_connection *)connection->priv)->flash_stream;
+	struct image image;
+	uint32_t written;
+
+	if (!chunk->size)
+		return;
+	chunk->size = 0;
+	if (stream->error != ERROR_OK)
+		return;
+
+	gdb_flash_stream_start(connection);
+
+	int retval = image_open(&image, "", "build");
+	if (retval == ERROR_OK)
+		retval = image_add_section(&image, chunk->address + chunk->begin,
+				chunk->end - chunk->begin, 0x0,
+				(uint8_t *)chunk->data.buf + chunk->begin);
+	if (retval == ERROR_OK)
+		retval = flash_write(get_target_from_connection(connection), &image, &written, false);
+	image_close(&image);
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("programming flash at " TARGET_ADDR_FMT " failed",
+				chunk->address + chunk->begin);
+		stream->error = retval;
+		return;
+	}
+	stream->written += written;
+}
+
+/* start a chunk of whole sectors, at least GDB_FLASH_CHUNK_SIZE long, at addr */
+static int gdb_flash_chunk_open(struct connection *connection,
+		struct gdb_flash_chunk *chunk, target_addr_t addr)
+{
+	struct flash_bank *bank;
+	int retval = get_flash_bank_by_addr(get_target_from_connection(connection),
+			addr, true, &bank);
+	if (retval != ERROR_OK)
+		return ERROR_FLASH_DST_OUT_OF_BANK;
+
+	uint32_t offset = addr - bank->base;
+	uint32_t start = ALIGN_DOWN(offset, GDB_FLASH_CHUNK_SIZE);
+	uint32_t end = MIN(start + GDB_FLASH_CHUNK_SIZE, bank->size);
+
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		struct flash_sector *sector = &bank->sectors[i];
+		if (offset < sector->offset || offset - sector->offset >= sector->size)
+			continue;
+
+		start = sector->offset;
+		end = start;
+		for (unsigned int j = i; j < bank->num_sectors && end - start < GDB_FLASH_CHUNK_SIZE; j++)
+			end = bank->sectors[j].offset + bank->sectors[j].size;
+		break;
+	}
+
+	uint8_t *data = gdb_scratch_get(&chunk->data, end - start);
+	if (!data) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	chunk->address = bank->base + start;
+	chunk->size = end - start;
+	chunk->begin = chunk->size;
+	chunk->end = 0;
+	memset(data, bank->default_padded_value, chunk->size);
+
+	return ERROR_OK;
+}
+
+static int gdb_flash_stream_add_range(struct gdb_flash_stream *stream,
+		target_addr_t start, target_addr_t end)
+{
+	if (stream->num_ranges && stream->ranges[stream->num_ranges - 1].end == start) {
+		stream->ranges[stream->num_ranges - 1].end = end;
+		return ERROR_OK;
+	}
+
+	if (stream->num_ranges == stream->max_ranges) {
+		unsigned int max_ranges = stream->max_ranges ? 2 * stream->max_ranges : 16;
+		struct gdb_flash_range *ranges = realloc(stream->ranges,
+				max_ranges * sizeof(*ranges));
+		if (!ranges) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		stream->ranges = ranges;
+		stream->max_ranges = max_ranges;
+	}
+
+	stream->ranges[stream->num_ranges].start = start;
+	stream->ranges[stream->num_ranges].end = end;
+	stream->num_ranges++;
+	return ERROR_OK;
+}
+
+/* @returns the first range of the chunks ending above addr, NULL if none */
+static const struct gdb_flash_range *gdb_flash_stream_find_range(const struct gdb_flash_stream *stream,
+		target_addr_t addr)
+{
+	unsigned int low = 0;
+	unsigned int high = stream->num_ranges;
+
+	while (low < high) {
+		unsigned int mid = (low + high) / 2;
+		if (stream->ranges[mid].end <= addr)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low < stream->num_ranges ? &stream->ranges[low] : NULL;
+}
+
+/* data for sectors of a programmed chunk is only accepted if already in flash */
+static int gdb_flash_stream_check(struct connection *connection,
+		target_addr_t addr, uint32_t length, const uint8_t *data)
+{
+	uint8_t *buffer = malloc(length);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	int retval = target_read_buffer(get_target_from_connection(connection),
+			addr, length, buffer);
+	if (retval == ERROR_OK && memcmp(buffer, data, length) != 0) {
+		LOG_ERROR("vFlashWrite at " TARGET_ADDR_FMT " out of order, "
+				"in flash sectors already programmed", addr);
+		retval = ERROR_FLASH_OPERATION_FAILED;
+	}
+
+	free(buffer);
+	return retval;
+}
+
+/* data that arrives out of order goes to the image programmed at vFlashDone,
+ * except in the sectors of the chunks, which can't be programmed twice */
+static int gdb_flash_stream_out_of_order(struct connection *connection,
+		target_addr_t addr, uint32_t length, const uint8_t *data)
+{
+	struct gdb_flash_stream *stream = &((struct gdb_connection *)connection->priv)->flash_stream;
+
+	LOG_DEBUG("vFlashWrite at " TARGET_ADDR_FMT " out of order", addr);
+
+	while (length) {
+		const struct gdb_flash_range *range = gdb_flash_stream_find_range(stream, addr);
+		uint32_t count = length;
+		int retval;
+
+		if (range && addr >= range->start) {
+			count = MIN(count, range->end - addr);
+			retval = gdb_flash_stream_check(connection, addr, count, data);
+		} else {
+			if (range)
+				count = MIN(count, range->start - addr);
+			retval = gdb_vflash_image_add(connection, addr, count, data);
+		}
+		if (retval != ERROR_OK)
+			return retval;
+
+		addr += count;
+		data += count;
+		length -= count;
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * Collect the data of a vFlashWrite packet into sector aligned chunks.
+ * GDB writes in increasing address order, so a chunk is complete when data
+ * beyond its end arrives. It is then left pending, to be programmed after
+ * the reply is sent. Data that arrives out of order is handled by
+ * gdb_flash_stream_out_of_order(), as no sector can be programmed twice.
+ */
+static int gdb_flash_stream_write(struct connection *connection,
+		target_addr_t addr, uint32_t length, const uint8_t *data)
+{
+	struct gdb_flash_stream *stream = &((struct gdb_connection *)connection->priv)->flash_stream;
+
+	while (length) {
+		struct gdb_flash_chunk *chunk = &stream->chunk[stream->filling];
+
+		if (chunk->size && addr >= chunk->address && addr - chunk->address >= chunk->size) {
+			/* in case a single packet completes two chunks */
+			if (stream->pending)
+				gdb_flash_chunk_program(connection, &stream->chunk[stream->filling ^ 1]);
+			stream->pending = true;
+			stream->filling ^= 1;
+			continue;
+		}
+
+		if (!chunk->size && addr >= stream->next) {
+			int retval = gdb_flash_chunk_open(connection, chunk, addr);
+			if (retval != ERROR_OK)
+				return retval;
+			if (chunk->address < stream->next) {
+				/* the first sector is already handled */
+				chunk->size = 0;
+			} else {
+				stream->next = chunk->address + chunk->size;
+				retval = gdb_flash_stream_add_range(stream, chunk->address,
+						stream->next);
+				if (retval != ERROR_OK)
+					return retval;
+			}
+		}
+
+		if (!chunk->size || addr < chunk->address) {
+			/* up to the chunk being filled, or to the next one */
+			uint32_t count = length;
+			if (chunk->size)
+				count = MIN(count, chunk->address - addr);
+			else if (addr < stream->next)
+				count = MIN(count, stream->next - addr);
+
+			int retval = gdb_flash_stream_out_of_order(connection, addr, count, data);
+			if (retval != ERROR_OK)
+				return retval;
+
+			addr += count;
+			data += count;
+			length -= count;
+			continue;
+		}
+
+		uint32_t offset = addr - chunk->address;
+		uint32_t count = MIN(length, chunk->size - offset);
+		memcpy((uint8_t *)chunk->data.buf + offset, data, count);
+		chunk->begin = MIN(chunk->begin, offset);
+		chunk->end = MAX(chunk->end, offset + count);
+
+		addr += count;
+		data += count;
+		length -= count;
+	}
+
+	return ERROR_OK;
+}
+
 static int gdb_v_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
@@ -3305,6 +4122,10 @@ static int gdb_v_packet(struct connection *connection,
 			return ERROR_SERVER_REMOTE_CLOSED;
 		}
 
+		/* a failed streaming load can end without vFlashDone */
+		if (gdb_connection->flash_stream.error != ERROR_OK)
+			gdb_flash_stream_reset(&gdb_connection->flash_stream);
+
 		/* assume all sectors need erasing - stops any problems
 		 * when flash_write is called multiple times */
 		flash_set_dirty();
@@ -3338,6 +4159,7 @@ static int gdb_v_packet(struct connection *connection,
 	}
 
 	if (strncmp(packet, "vFlashWrite:", 12) == 0) {
+		struct gdb_flash_stream *stream = &gdb_connection->flash_stream;
 		int retval;
 		unsigned long addr;
 		unsigned long length;
@@ -3354,47 +4176,70 @@ static int gdb_v_packet(struct connection *connection,
 		}
 		length = packet_size - (parse - packet);
 
-		/* create a new image if there isn't already one */
-		if (!gdb_connection->vflash_image) {
-			gdb_connection->vflash_image = malloc(sizeof(struct image));
-			image_open(gdb_connection->vflash_image, "", "build");
+		if (!gdb_flash_stream) {
+			retval = gdb_vflash_image_add(connection, addr, length, (uint8_t const *)parse);
+			if (retval != ERROR_OK)
+				return retval;
+
+			gdb_put_packet(connection, "OK", 2);
+			return ERROR_OK;
 		}
 
-		/* create new section with content from packet buffer */
-		retval = image_add_section(gdb_connection->vflash_image,
-				addr, length, 0x0, (uint8_t const *)parse);
-		if (retval != ERROR_OK)
-			return retval;
+		if (stream->error == ERROR_OK)
+			stream->error = gdb_flash_stream_write(connection, addr, length,
+					(uint8_t const *)parse);
+		if (stream->error != ERROR_OK) {
+			gdb_flash_error(connection, stream->error);
+			return ERROR_OK;
+		}
 
 		gdb_put_packet(connection, "OK", 2);
 
+		/* let GDB send the next packets while the chunk is programmed */
+		if (stream->pending) {
+			gdb_flush(connection);
+			gdb_flash_chunk_program(connection, &stream->chunk[stream->filling ^ 1]);
+			stream->pending = false;
+		}
+
 		return ERROR_OK;
 	}
 
 	if (strncmp(packet, "vFlashDone", 10) == 0) {
-		uint32_t written;
+		struct gdb_flash_stream *stream = &gdb_connection->flash_stream;
+		uint32_t written = 0;
+
+		/* program what is left of the stream */
+		for (unsigned int i = 0; i < 2; i++)
+			gdb_flash_chunk_program(connection, &stream->chunk[stream->filling ^ 1 ^ i]);
+		result = stream->error;
+		written = stream->written;
 
 		/* process the flashing buffer. No need to erase as GDB
 		 * always issues a vFlashErase first. */
-		target_call_event_callbacks(target,
-				TARGET_EVENT_GDB_FLASH_WRITE_START);
-		result = flash_write(target, gdb_connection->vflash_image,
-			&written, false);
+		gdb_flash_stream_start(connection);
+		if (result == ERROR_OK && gdb_connection->vflash_image) {
+			uint32_t image_written;
+
+			result = flash_write(target, gdb_connection->vflash_image,
+				&image_written, false);
+			written += image_written;
+		}
 		target_call_event_callbacks(target,
 			TARGET_EVENT_GDB_FLASH_WRITE_END);
 		if (result != ERROR_OK) {
-			if (result == ERROR_FLASH_DST_OUT_OF_BANK)
-				gdb_put_packet(connection, "E.memtype", 9);
-			else
-				gdb_send_error(connection, EIO);
+			gdb_flash_error(connection, result);
 		} else {
 			LOG_DEBUG("wrote %u bytes from vFlash image to flash", (unsigned)written);
 			gdb_put_packet(connection, "OK", 2);
 		}
 
-		image_close(gdb_connection->vflash_image);
-		free(gdb_connection->vflash_image);
-		gdb_connection->vflash_image = NULL;
+		gdb_flash_stream_reset(stream);
+		if (gdb_connection->vflash_image) {
+			image_close(gdb_connection->vflash_image);
+			free(gdb_connection->vflash_image);
+			gdb_connection->vflash_image = NULL;
+		}
 
 		return ERROR_OK;
 	}
@@ -3513,6 +4358,9 @@ static int gdb_input_inner(struct connection *connection)
 	 * drain the rest of the buffer.
 	 */
 	do {
+		if (!gdb_con->prefetch_done)
+			gdb_prefetch_memory(connection);
+
 		packet_size = GDB_BUFFER_SIZE;
 		retval = gdb_get_packet(connection, gdb_packet_buffer, &packet_size);
 		if (retval != ERROR_OK)
@@ -3525,6 +4373,10 @@ static int gdb_input_inner(struct connection *connection)
 
 			gdb_log_incoming_packet(connection, gdb_packet_buffer);
 
+			/* the memory read ahead is valid until a packet can change it */
+			if (!strchr("gmpx", packet[0]))
+				gdb_prefetch_drop(gdb_con);
+
 			retval = ERROR_OK;
 			switch (packet[0]) {
 				case 'T':	/* Is thread alive? */
@@ -3553,6 +4405,7 @@ static int gdb_input_inner(struct connection *connection)
 					retval = gdb_set_register_packet(connection, packet, packet_size);
 					break;
 				case 'm':
+				case 'x':
 					retval = gdb_read_memory_packet(connection, packet, packet_size);
 					break;
 				case 'M':
@@ -3732,8 +4585,18 @@ static int gdb_input_inner(struct connection *connection)
 
 static int gdb_input(struct connection *connection)
 {
-	int retval = gdb_input_inner(connection);
 	struct gdb_connection *gdb_con = connection->priv;
+
+	/* replies to all the packets already received go out together */
+	gdb_con->out_defer = true;
+	int retval = gdb_input_inner(connection);
+	gdb_con->out_defer = false;
+	gdb_prefetch_drop(gdb_con);
+
+	int flush_retval = gdb_flush(connection);
+	if (retval == ERROR_OK)
+		retval = flush_retval;
+
 	if (retval == ERROR_SERVER_REMOTE_CLOSED)
 		return retval;
 
@@ -3754,6 +4617,9 @@ static void gdb_keep_client_alive(struct connection *connection)
 		return;
 	}
 
+	/* a long running command must not hold back the replies queued so far */
+	gdb_flush(connection);
+
 	switch (gdb_con->output_flag) {
 	case GDB_OUTPUT_NO:
 		/* no need for keep-alive */
@@ -3922,6 +4788,15 @@ COMMAND_HANDLER(handle_gdb_flash_program_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_gdb_flash_stream_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ENABLE(CMD_ARGV[0], gdb_flash_stream);
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_gdb_report_data_abort_command)
 {
 	if (CMD_ARGC != 1)
@@ -3975,17 +4850,12 @@ COMMAND_HANDLER(handle_gdb_target_description_command)
 
 COMMAND_HANDLER(handle_gdb_save_tdesc_command)
 {
-	char *tdesc;
-	uint32_t tdesc_length;
 	struct target *target = get_current_target(CMD_CTX);
+	int retval;
 
-	int retval = gdb_generate_target_description(target, &tdesc);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Unable to Generate Target Description");
+	struct gdb_tdesc_cache *cache = gdb_get_target_description(target, true);
+	if (!cache)
 		return ERROR_FAIL;
-	}
-
-	tdesc_length = strlen(tdesc);
 
 	struct fileio *fileio;
 	size_t size_written;
@@ -4003,7 +4873,7 @@ COMMAND_HANDLER(handle_gdb_save_tdesc_command)
 		goto out;
 	}
 
-	retval = fileio_write(fileio, tdesc_length, tdesc, &size_written);
+	retval = fileio_write(fileio, cache->tdesc_length, cache->tdesc, &size_written);
 
 	fileio_close(fileio);
 
@@ -4012,7 +4882,6 @@ COMMAND_HANDLER(handle_gdb_save_tdesc_command)
 
 out:
 	free(tdesc_filename);
-	free(tdesc);
 
 	return retval;
 }
@@ -4054,6 +4923,13 @@ static const struct command_registration gdb_command_handlers[] = {
 		.help = "enable or disable flash program",
 		.usage = "('enable'|'disable')"
 	},
+	{
+		.name = "gdb_flash_stream",
+		.handler = handle_gdb_flash_stream_command,
+		.mode = COMMAND_CONFIG,
+		.help = "enable or disable flash programming while GDB sends the data",
+		.usage = "('enable'|'disable')"
+	},
 	{
 		.name = "gdb_report_data_abort",
 		.handler = handle_gdb_report_data_abort_command,
@@ -4104,6 +4980,7 @@ void gdb_service_free(void)
 {
 	free(gdb_port);
 	free(gdb_port_next);
+	gdb_free_target_descriptions();
 }
 
 int gdb_get_actual_connections(void)
@@ -34,8 +34,119 @@
 #include <netinet/tcp.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 static struct service *services;
 
+/* maximum number of ready file descriptors handled in one loop iteration */
+#define SERVER_MAX_EVENTS	64
+
+/*
+ * Readiness notification backend of server_loop().
+ *
+ * The select() backend rebuilds the fd_set from the list of services and
+ * connections on every iteration. The epoll backend keeps every listening
+ * socket and connection registered in the kernel and only dispatches the file
+ * descriptors that are ready, so the cost of an iteration does not depend on
+ * the number of idle services.
+ * epoll refuses regular files (e.g. stdin redirected from a file), in that
+ * case the server falls back to select() for the rest of the session.
+ */
+#ifdef HAVE_SYS_EPOLL_H
+struct server_watch {
+	struct service *service;
+	/* NULL when watching the listening fd of the service */
+	struct connection *connection;
+	/* distinguishes a recycled fd from the one an event was queued for */
+	uint32_t generation;
+};
+
+static bool server_use_epoll = true;
+static int server_epoll_fd = -1;
+/* indexed by file descriptor */
+static struct server_watch *server_watches;
+static int server_watches_size;
+static uint32_t server_watch_generation;
+static struct epoll_event server_events[SERVER_MAX_EVENTS];
+#endif
+
+static fd_set server_read_fds;
+
+static void server_watch_disable_epoll(void)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	if (server_epoll_fd != -1)
+		close(server_epoll_fd);
+	server_epoll_fd = -1;
+	free(server_watches);
+	server_watches = NULL;
+	server_watches_size = 0;
+	server_use_epoll = false;
+#endif
+}
+
+static void server_watch_add(int fd, struct service *service, struct connection *connection)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	if (!server_use_epoll || fd < 0)
+		return;
+
+	if (server_epoll_fd == -1) {
+		server_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (server_epoll_fd == -1) {
+			LOG_DEBUG("epoll not available (%s), using select", strerror(errno));
+			server_watch_disable_epoll();
+			return;
+		}
+	}
+
+	if (fd >= server_watches_size) {
+		int new_size = MAX(fd + 1, 2 * server_watches_size);
+		struct server_watch *new_watches = realloc(server_watches, new_size * sizeof(*new_watches));
+		if (!new_watches) {
+			LOG_ERROR("Out of memory, using select");
+			server_watch_disable_epoll();
+			return;
+		}
+		memset(&new_watches[server_watches_size], 0,
+			(new_size - server_watches_size) * sizeof(*new_watches));
+		server_watches = new_watches;
+		server_watches_size = new_size;
+	}
+
+	struct server_watch *w = &server_watches[fd];
+	w->service = service;
+	w->connection = connection;
+	w->generation = ++server_watch_generation;
+
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+		.data.u64 = ((uint64_t)w->generation << 32) | (uint32_t)fd,
+	};
+	if (epoll_ctl(server_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+		LOG_DEBUG("cannot watch fd %d with epoll (%s), using select", fd, strerror(errno));
+		server_watch_disable_epoll();
+	}
+#endif
+}
+
+static void server_watch_del(int fd)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	if (!server_use_epoll || fd < 0 || fd >= server_watches_size)
+		return;
+
+	if (!server_watches[fd].service)
+		return;
+
+	server_watches[fd].service = NULL;
+	server_watches[fd].connection = NULL;
+	epoll_ctl(server_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+#endif
+}
+
 enum shutdown_reason {
 	CONTINUE_MAIN_LOOP,			/* stay in main event loop */
 	SHUTDOWN_REQUESTED,			/* set by shutdown command; exit the event loop and quit the debugger */
@@ -141,6 +252,10 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 		}
 	}
 
+	/* pipe connections take over the fd the service was listening on */
+	server_watch_del(c->fd);
+	server_watch_add(c->fd, service, c);
+
 	/* add to the end of linked list */
 	for (p = &service->connections; *p; p = &(*p)->next)
 		;
@@ -160,12 +275,14 @@ static int remove_connection(struct service *service, struct connection *connect
 	/* find connection */
 	while ((c = *p)) {
 		if (c->fd == connection->fd) {
+			server_watch_del(c->fd);
 			service->connection_closed(c);
 			if (service->type == CONNECTION_TCP)
 				close_socket(c->fd);
 			else if (service->type == CONNECTION_PIPE) {
 				/* The service will listen to the pipe again */
 				c->service->fd = c->fd;
+				server_watch_add(c->fd, service, NULL);
 			}
 
 			command_done(c->cmd_ctx);
@@ -328,6 +445,8 @@ int add_service(const struct service_driver *driver, const char *port,
 #endif
 	}
 
+	server_watch_add(c->fd, c, NULL);
+
 	/* add to the end of linked list */
 	for (p = &services; *p; p = &(*p)->next)
 		;
@@ -367,6 +486,7 @@ int remove_service(const char *name, const char *port)
 			else
 				prev->next = tmp->next;
 
+			server_watch_del(tmp->fd);
 			if (tmp->type != CONNECTION_STDINOUT)
 				close_socket(tmp->fd);
 
@@ -392,6 +512,7 @@ static int remove_services(void)
 
 		free(c->name);
 
+		server_watch_del(c->fd);
 		if (c->type == CONNECTION_PIPE) {
 			if (c->fd != -1)
 				close(c->fd);
@@ -407,6 +528,8 @@ static int remove_services(void)
 
 	services = NULL;
 
+	server_watch_disable_epoll();
+
 	return ERROR_OK;
 }
 
@@ -418,106 +541,213 @@ void server_keep_clients_alive(void)
 				s->keep_client_alive(c);
 }
 
-int server_loop(struct command_context *command_context)
+/* wait for activity on the listening sockets and connections, select backend */
+static int server_wait_select(int timeout_ms, int *ready)
 {
-	struct service *service;
+	int fd_max = 0;
 
-	bool poll_ok = true;
+	FD_ZERO(&server_read_fds);
 
-	/* used in select() */
-	fd_set read_fds;
-	int fd_max;
+	/* add service and connection fds to read_fds */
+	for (struct service *service = services; service; service = service->next) {
+		if (service->fd != -1) {
+			/* listen for new connections */
+			FD_SET(service->fd, &server_read_fds);
 
-	/* used in accept() */
-	int retval;
+			if (service->fd > fd_max)
+				fd_max = service->fd;
+		}
 
-	int64_t next_event = timeval_ms() + polling_period;
+		for (struct connection *c = service->connections; c; c = c->next) {
+			/* check for activity on the connection */
+			FD_SET(c->fd, &server_read_fds);
+			if (c->fd > fd_max)
+				fd_max = c->fd;
+		}
+	}
 
-#ifndef _WIN32
-	if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
-		LOG_ERROR("couldn't set SIGPIPE to SIG_IGN");
+	struct timeval tv;
+	tv.tv_sec = 0;
+	tv.tv_usec = timeout_ms * 1000;
+	int retval = socket_select(fd_max + 1, &server_read_fds, NULL, NULL, &tv);
+
+	if (retval == -1) {
+#ifdef _WIN32
+		errno = WSAGetLastError();
+		bool interrupted = errno == WSAEINTR;
+#else
+		bool interrupted = errno == EINTR;
 #endif
+		if (!interrupted) {
+			LOG_ERROR("error during select: %s", strerror(errno));
+			return ERROR_FAIL;
+		}
+	}
 
-	while (shutdown_openocd == CONTINUE_MAIN_LOOP) {
-		/* monitor sockets for activity */
-		fd_max = 0;
-		FD_ZERO(&read_fds);
-
-		/* add service and connection fds to read_fds */
-		for (service = services; service; service = service->next) {
-			if (service->fd != -1) {
-				/* listen for new connections */
-				FD_SET(service->fd, &read_fds);
-
-				if (service->fd > fd_max)
-					fd_max = service->fd;
-			}
+	if (retval <= 0) {
+		/* eCos leaves read_fds unchanged in case of timeout! */
+		FD_ZERO(&server_read_fds);
+	}
+
+	*ready = retval;
+	return ERROR_OK;
+}
 
-			if (service->connections) {
-				struct connection *c;
+#ifdef HAVE_SYS_EPOLL_H
+/* wait for activity on the listening sockets and connections, epoll backend */
+static int server_wait_epoll(int timeout_ms, int *ready)
+{
+	int retval = epoll_wait(server_epoll_fd, server_events, SERVER_MAX_EVENTS, timeout_ms);
 
-				for (c = service->connections; c; c = c->next) {
-					/* check for activity on the connection */
-					FD_SET(c->fd, &read_fds);
-					if (c->fd > fd_max)
-						fd_max = c->fd;
-				}
-			}
+	if (retval == -1 && errno != EINTR) {
+		LOG_ERROR("error during epoll_wait: %s", strerror(errno));
+		return ERROR_FAIL;
+	}
+
+	*ready = retval;
+	return ERROR_OK;
+}
+#endif
+
+static void server_accept(struct service *service, struct command_context *command_context)
+{
+	if (service->max_connections != 0) {
+		add_connection(service, command_context);
+		return;
+	}
+
+	if (service->type == CONNECTION_TCP) {
+		struct sockaddr_in sin;
+		socklen_t address_size = sizeof(sin);
+		int tmp_fd;
+		tmp_fd = accept(service->fd,
+				(struct sockaddr *)&service->sin,
+				&address_size);
+		close_socket(tmp_fd);
+	}
+	LOG_INFO("rejected '%s' connection, no more connections allowed",
+		service->name);
+}
+
+static void server_input(struct service *service, struct connection *c)
+{
+	int retval = service->input(c);
+	if (retval == ERROR_OK)
+		return;
+
+	if (service->type == CONNECTION_PIPE ||
+			service->type == CONNECTION_STDINOUT) {
+		/* if connection uses a pipe then
+		 * shutdown openocd on error */
+		shutdown_openocd = SHUTDOWN_REQUESTED;
+	}
+	remove_connection(service, c);
+	LOG_INFO("dropped '%s' connection", service->name);
+}
+
+/* handle the fds reported by server_wait_select() */
+static void server_dispatch_select(struct command_context *command_context)
+{
+	for (struct service *service = services; service; service = service->next) {
+		/* handle new connections on listeners */
+		if (service->fd != -1 && FD_ISSET(service->fd, &server_read_fds))
+			server_accept(service, command_context);
+
+		/* handle activity on connections */
+		for (struct connection *c = service->connections; c; ) {
+			struct connection *next = c->next;
+			if ((c->fd >= 0 && FD_ISSET(c->fd, &server_read_fds)) || c->input_pending)
+				server_input(service, c);
+			c = next;
 		}
+	}
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+/* handle the fds reported by server_wait_epoll() */
+static void server_dispatch_epoll(struct command_context *command_context, int ready)
+{
+	for (int i = 0; i < ready; i++) {
+		int fd = (int)(uint32_t)server_events[i].data.u64;
+		uint32_t generation = server_events[i].data.u64 >> 32;
+
+		/* a handler called earlier in this loop can close any fd, even
+		 * disabling the epoll backend */
+		if (!server_use_epoll || fd >= server_watches_size)
+			break;
+
+		struct server_watch *w = &server_watches[fd];
+		if (!w->service || w->generation != generation)
+			continue;
 
-		struct timeval tv;
-		tv.tv_sec = 0;
-		if (poll_ok) {
-			/* we're just polling this iteration, this is faster on embedded
-			 * hosts */
-			tv.tv_usec = 0;
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+		if (!w->connection) {
+			if (w->service->fd == fd)
+				server_accept(w->service, command_context);
 		} else {
-			/* Timeout socket_select() when a target timer expires or every polling_period */
-			int timeout_ms = next_event - timeval_ms();
-			if (timeout_ms < 0)
-				timeout_ms = 0;
-			else if (timeout_ms > polling_period)
-				timeout_ms = polling_period;
-			tv.tv_usec = timeout_ms * 1000;
-			/* Only while we're sleeping we'll let others run */
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+			server_input(w->service, w->connection);
 		}
+	}
 
-		if (retval == -1) {
-#ifdef _WIN32
+	/* connections with buffered but not yet processed input */
+	for (struct service *service = services; service; service = service->next) {
+		for (struct connection *c = service->connections; c; ) {
+			struct connection *next = c->next;
+			if (c->input_pending)
+				server_input(service, c);
+			c = next;
+		}
+	}
+}
+#endif
 
-			errno = WSAGetLastError();
+int server_loop(struct command_context *command_context)
+{
+	bool poll_ok = true;
+	int ready;
+	int retval;
 
-			if (errno == WSAEINTR)
-				FD_ZERO(&read_fds);
-			else {
-				LOG_ERROR("error during select: %s", strerror(errno));
-				return ERROR_FAIL;
-			}
-#else
+	int64_t next_event = timeval_ms() + polling_period;
 
-			if (errno == EINTR)
-				FD_ZERO(&read_fds);
-			else {
-				LOG_ERROR("error during select: %s", strerror(errno));
-				return ERROR_FAIL;
-			}
+#ifndef _WIN32
+	if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
+		LOG_ERROR("couldn't set SIGPIPE to SIG_IGN");
 #endif
+
+	while (shutdown_openocd == CONTINUE_MAIN_LOOP) {
+		int timeout_ms = 0;
+		if (!poll_ok) {
+			/* Timeout when a target timer expires or every polling_period */
+			timeout_ms = next_event - timeval_ms();
+			if (timeout_ms < 0)
+				timeout_ms = 0;
+			else if (timeout_ms > polling_period)
+				timeout_ms = polling_period;
 		}
+		/* else we're just polling this iteration, this is faster on
+		 * embedded hosts */
+
+		/* monitor sockets for activity, only while we're sleeping we'll
+		 * let others run */
+#ifdef HAVE_SYS_EPOLL_H
+		bool use_epoll = server_use_epoll && server_epoll_fd != -1;
+		if (use_epoll)
+			retval = server_wait_epoll(timeout_ms, &ready);
+		else
+#endif
+			retval = server_wait_select(timeout_ms, &ready);
+		if (retval != ERROR_OK)
+			return retval;
 
-		if (retval == 0) {
+		if (ready == 0) {
 			/* Execute callbacks of expired timers when
 			 * - there was nothing to do if poll_ok was true
-			 * - socket_select() timed out if poll_ok was false, now one or more
+			 * - the wait timed out if poll_ok was false, now one or more
 			 *   timers expired or the polling period elapsed
 			 */
 			target_call_timer_callbacks();
 			next_event = target_timer_next_event();
 			process_jim_events(command_context);
 
-			FD_ZERO(&read_fds);	/* eCos leaves read_fds unchanged in this case!  */
-
 			/* We timed out/there was nothing to do, timeout rather than poll next time
 			 **/
 			poll_ok = false;
@@ -533,54 +763,12 @@ int server_loop(struct command_context *command_context)
 		 */
 		poll_ok = poll_ok || target_got_message();
 
-		for (service = services; service; service = service->next) {
-			/* handle new connections on listeners */
-			if ((service->fd != -1)
-				&& (FD_ISSET(service->fd, &read_fds))) {
-				if (service->max_connections != 0)
-					add_connection(service, command_context);
-				else {
-					if (service->type == CONNECTION_TCP) {
-						struct sockaddr_in sin;
-						socklen_t address_size = sizeof(sin);
-						int tmp_fd;
-						tmp_fd = accept(service->fd,
-								(struct sockaddr *)&service->sin,
-								&address_size);
-						close_socket(tmp_fd);
-					}
-					LOG_INFO(
-						"rejected '%s' connection, no more connections allowed",
-						service->name);
-				}
-			}
-
-			/* handle activity on connections */
-			if (service->connections) {
-				struct connection *c;
-
-				for (c = service->connections; c; ) {
-					if ((c->fd >= 0 && FD_ISSET(c->fd, &read_fds)) || c->input_pending) {
-						retval = service->input(c);
-						if (retval != ERROR_OK) {
-							struct connection *next = c->next;
-							if (service->type == CONNECTION_PIPE ||
-									service->type == CONNECTION_STDINOUT) {
-								/* if connection uses a pipe then
-								 * shutdown openocd on error */
-								shutdown_openocd = SHUTDOWN_REQUESTED;
-							}
-							remove_connection(service, c);
-							LOG_INFO("dropped '%s' connection",
-								service->name);
-							c = next;
-							continue;
-						}
-					}
-					c = c->next;
-				}
-			}
-		}
+#ifdef HAVE_SYS_EPOLL_H
+		if (use_epoll)
+			server_dispatch_epoll(command_context, MAX(ready, 0));
+		else
+#endif
+			server_dispatch_select(command_context);
 
 #ifdef _WIN32
 		MSG msg;
@@ -739,6 +927,49 @@ int connection_write(struct connection *connection, const void *data, int len)
 		return write(connection->fd_out, data, len);
 }
 
+/**
+ * Write the buffers described by @a iov, in order, with as few system calls
+ * as possible. The content of @a iov is modified.
+ * @returns the number of bytes written, or -1 on error.
+ */
+int connection_writev(struct connection *connection, struct iovec *iov, int iovcnt)
+{
+	int written = 0;
+
+	while (iovcnt > 0) {
+		if (!iov->iov_len) {
+			iov++;
+			iovcnt--;
+			continue;
+		}
+
+#ifdef _WIN32
+		int retval = connection_write(connection, iov->iov_base, iov->iov_len);
+#else
+		ssize_t retval = writev(connection->fd_out, iov, iovcnt);
+		if (retval < 0 && errno == EINTR)
+			continue;
+#endif
+		if (retval <= 0)
+			return -1;
+		written += retval;
+
+		/* skip what has been written, the last buffer can be partially done */
+		size_t done = retval;
+		while (iovcnt > 0 && done >= iov->iov_len) {
+			done -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (char *)iov->iov_base + done;
+			iov->iov_len -= done;
+		}
+	}
+
+	return written;
+}
+
 int connection_read(struct connection *connection, void *data, int len)
 {
 	if (connection->service->type == CONNECTION_TCP)
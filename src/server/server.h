@@ -25,6 +25,10 @@
 #include <netinet/in.h>
 #endif
 
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
 enum connection_type {
 	CONNECTION_TCP,
 	CONNECTION_PIPE,
@@ -102,6 +106,7 @@ int server_loop(struct command_context *command_context);
 int server_register_commands(struct command_context *context);
 
 int connection_write(struct connection *connection, const void *data, int len);
+int connection_writev(struct connection *connection, struct iovec *iov, int iovcnt);
 int connection_read(struct connection *connection, void *data, int len);
 
 bool openocd_is_shutdown_pending(void);
@@ -26,7 +26,7 @@ void destroy_mem_param(struct mem_param *param)
 	param->value = NULL;
 }
 
-void init_reg_param(struct reg_param *param, char *reg_name, uint32_t size, enum param_direction direction)
+void init_reg_param(struct reg_param *param, const char *reg_name, uint32_t size, enum param_direction direction)
 {
 	param->reg_name = reg_name;
 	param->size = size;
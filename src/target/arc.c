@@ -1708,6 +1708,7 @@ static void arc_reset_actionpoints(struct target *target)
 		free(target->breakpoints);
 		target->breakpoints = next_b;
 	}
+	breakpoint_list_changed(target);
 	while (target->watchpoints) {
 		next_w = target->watchpoints->next;
 		arc_remove_watchpoint(target, target->watchpoints);
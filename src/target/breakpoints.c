@@ -31,41 +31,238 @@ static const char * const watchpoint_rw_strings[] = {
 /* monotonic counter/id-number for breakpoints and watch points */
 static int bpwp_unique_id;
 
+/* order of target->breakpoint_index: address, then order of the list */
+static int breakpoint_index_cmp(const void *a, const void *b)
+{
+	const struct breakpoint *bp_a = *(const struct breakpoint **)a;
+	const struct breakpoint *bp_b = *(const struct breakpoint **)b;
+
+	if (bp_a->address != bp_b->address)
+		return bp_a->address < bp_b->address ? -1 : 1;
+	if (bp_a->unique_id != bp_b->unique_id)
+		return bp_a->unique_id < bp_b->unique_id ? -1 : 1;
+	return 0;
+}
+
+/* @returns the position of the first breakpoint at or above address */
+static unsigned int breakpoint_index_lower(const struct breakpoint_index *index,
+	target_addr_t address)
+{
+	unsigned int low = 0;
+	unsigned int high = index->count;
+
+	while (low < high) {
+		unsigned int mid = low + (high - low) / 2;
+		if (index->sorted[mid]->address < address)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+/* @returns the position of the first breakpoint above address */
+static unsigned int breakpoint_index_upper(const struct breakpoint_index *index,
+	target_addr_t address)
+{
+	unsigned int low = 0;
+	unsigned int high = index->count;
+
+	while (low < high) {
+		unsigned int mid = low + (high - low) / 2;
+		if (index->sorted[mid]->address <= address)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+static int breakpoint_index_reserve(struct breakpoint_index *index, unsigned int count)
+{
+	if (count <= index->size)
+		return ERROR_OK;
+
+	unsigned int size = MAX(index->size * 2, 16u);
+	while (size < count)
+		size *= 2;
+
+	struct breakpoint **sorted = realloc(index->sorted, size * sizeof(*sorted));
+	if (!sorted) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	index->sorted = sorted;
+	index->size = size;
+
+	return ERROR_OK;
+}
+
+void breakpoint_list_changed(struct target *target)
+{
+	struct breakpoint_index *index = target->breakpoint_index;
+	unsigned int count = 0;
+
+	if (!index)
+		return;
+
+	index->count = 0;
+	index->last = NULL;
+	for (struct breakpoint *bp = target->breakpoints; bp; bp = bp->next)
+		count++;
+	if (breakpoint_index_reserve(index, count) != ERROR_OK) {
+		/* breakpoint_index_get() retries */
+		free(index->sorted);
+		free(index);
+		target->breakpoint_index = NULL;
+		return;
+	}
+
+	for (struct breakpoint *bp = target->breakpoints; bp; bp = bp->next) {
+		index->sorted[index->count++] = bp;
+		index->last = bp;
+	}
+	if (index->count)
+		qsort(index->sorted, index->count, sizeof(*index->sorted), breakpoint_index_cmp);
+}
+
+static struct breakpoint_index *breakpoint_index_get(struct target *target)
+{
+	if (!target->breakpoint_index) {
+		target->breakpoint_index = calloc(1, sizeof(struct breakpoint_index));
+		if (!target->breakpoint_index) {
+			LOG_ERROR("Out of memory");
+			return NULL;
+		}
+		breakpoint_list_changed(target);
+	}
+
+	return target->breakpoint_index;
+}
+
+void breakpoint_index_free(struct target *target)
+{
+	if (!target->breakpoint_index)
+		return;
+
+	free(target->breakpoint_index->sorted);
+	free(target->breakpoint_index);
+	target->breakpoint_index = NULL;
+}
+
+/* append a new breakpoint to the list and to the index */
+static int breakpoint_link(struct target *target, struct breakpoint *breakpoint)
+{
+	struct breakpoint_index *index = breakpoint_index_get(target);
+
+	if (!index || breakpoint_index_reserve(index, index->count + 1) != ERROR_OK)
+		return ERROR_FAIL;
+
+	breakpoint->next = NULL;
+	if (index->last)
+		index->last->next = breakpoint;
+	else
+		target->breakpoints = breakpoint;
+	index->last = breakpoint;
+
+	/* unique ids grow, so the new breakpoint goes after those at the same address */
+	unsigned int pos = breakpoint_index_upper(index, breakpoint->address);
+	memmove(&index->sorted[pos + 1], &index->sorted[pos],
+		(index->count - pos) * sizeof(*index->sorted));
+	index->sorted[pos] = breakpoint;
+	index->count++;
+
+	return ERROR_OK;
+}
+
+static void breakpoint_unlink(struct target *target, struct breakpoint *breakpoint)
+{
+	struct breakpoint_index *index = target->breakpoint_index;
+	struct breakpoint **breakpoint_p = &target->breakpoints;
+	struct breakpoint *prev = NULL;
+
+	while (*breakpoint_p && *breakpoint_p != breakpoint) {
+		prev = *breakpoint_p;
+		breakpoint_p = &prev->next;
+	}
+	if (!*breakpoint_p)
+		return;
+	*breakpoint_p = breakpoint->next;
+
+	if (!index)
+		return;
+	if (index->last == breakpoint)
+		index->last = prev;
+
+	for (unsigned int pos = breakpoint_index_lower(index, breakpoint->address);
+			pos < index->count && index->sorted[pos]->address == breakpoint->address;
+			pos++) {
+		if (index->sorted[pos] != breakpoint)
+			continue;
+		index->count--;
+		memmove(&index->sorted[pos], &index->sorted[pos + 1],
+			(index->count - pos) * sizeof(*index->sorted));
+		break;
+	}
+}
+
+static struct breakpoint *breakpoint_new(target_addr_t address, uint32_t asid,
+	uint32_t length, enum breakpoint_type type)
+{
+	struct breakpoint *breakpoint = malloc(sizeof(struct breakpoint));
+	if (!breakpoint)
+		return NULL;
+
+	breakpoint->address = address;
+	breakpoint->asid = asid;
+	breakpoint->length = length;
+	breakpoint->type = type;
+	breakpoint->is_set = false;
+	breakpoint->orig_instr = malloc(length);
+	breakpoint->next = NULL;
+	breakpoint->unique_id = bpwp_unique_id++;
+
+	return breakpoint;
+}
+
+static void breakpoint_delete(struct target *target, struct breakpoint *breakpoint)
+{
+	breakpoint_unlink(target, breakpoint);
+	free(breakpoint->orig_instr);
+	free(breakpoint);
+}
+
 static int breakpoint_add_internal(struct target *target,
 	target_addr_t address,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
+	struct breakpoint *breakpoint = breakpoint_find(target, address);
 	const char *reason;
 	int retval;
 
-	while (breakpoint) {
-		if (breakpoint->address == address) {
-			/* FIXME don't assume "same address" means "same
-			 * breakpoint" ... check all the parameters before
-			 * succeeding.
-			 */
-			LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
-				address, breakpoint->unique_id);
-			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
-		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
+	if (breakpoint) {
+		/* FIXME don't assume "same address" means "same
+		 * breakpoint" ... check all the parameters before
+		 * succeeding.
+		 */
+		LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
+			address, breakpoint->unique_id);
+		return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 	}
 
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = address;
-	(*breakpoint_p)->asid = 0;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->is_set = false;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
+	breakpoint = breakpoint_new(address, 0, length, type);
+	if (!breakpoint || breakpoint_link(target, breakpoint) != ERROR_OK) {
+		LOG_ERROR("Out of memory");
+		if (breakpoint)
+			free(breakpoint->orig_instr);
+		free(breakpoint);
+		return ERROR_FAIL;
+	}
 
-	retval = target_add_breakpoint(target, *breakpoint_p);
+	retval = target_add_breakpoint(target, breakpoint);
 	switch (retval) {
 		case ERROR_OK:
 			break;
@@ -79,18 +276,16 @@ static int breakpoint_add_internal(struct target *target,
 			reason = "unknown reason";
 fail:
 			LOG_ERROR("can't add breakpoint: %s", reason);
-			free((*breakpoint_p)->orig_instr);
-			free(*breakpoint_p);
-			*breakpoint_p = NULL;
+			breakpoint_delete(target, breakpoint);
 			return retval;
 	}
 
 	LOG_DEBUG("[%d] added %s breakpoint at " TARGET_ADDR_FMT
 			" of length 0x%8.8x, (BPID: %" PRIu32 ")",
 		target->coreid,
-		breakpoint_type_strings[(*breakpoint_p)->type],
-		(*breakpoint_p)->address, (*breakpoint_p)->length,
-		(*breakpoint_p)->unique_id);
+		breakpoint_type_strings[breakpoint->type],
+		breakpoint->address, breakpoint->length,
+		breakpoint->unique_id);
 
 	return ERROR_OK;
 }
@@ -101,7 +296,6 @@ static int context_breakpoint_add_internal(struct target *target,
 	enum breakpoint_type type)
 {
 	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
 	int retval;
 
 	while (breakpoint) {
@@ -114,32 +308,29 @@ static int context_breakpoint_add_internal(struct target *target,
 				asid, breakpoint->unique_id);
 			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 		}
-		breakpoint_p = &breakpoint->next;
 		breakpoint = breakpoint->next;
 	}
 
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = 0;
-	(*breakpoint_p)->asid = asid;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->is_set = false;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
-	retval = target_add_context_breakpoint(target, *breakpoint_p);
+	breakpoint = breakpoint_new(0, asid, length, type);
+	if (!breakpoint || breakpoint_link(target, breakpoint) != ERROR_OK) {
+		LOG_ERROR("Out of memory");
+		if (breakpoint)
+			free(breakpoint->orig_instr);
+		free(breakpoint);
+		return ERROR_FAIL;
+	}
+
+	retval = target_add_context_breakpoint(target, breakpoint);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("could not add breakpoint");
-		free((*breakpoint_p)->orig_instr);
-		free(*breakpoint_p);
-		*breakpoint_p = NULL;
+		breakpoint_delete(target, breakpoint);
 		return retval;
 	}
 
 	LOG_DEBUG("added %s Context breakpoint at 0x%8.8" PRIx32 " of length 0x%8.8x, (BPID: %" PRIu32 ")",
-		breakpoint_type_strings[(*breakpoint_p)->type],
-		(*breakpoint_p)->asid, (*breakpoint_p)->length,
-		(*breakpoint_p)->unique_id);
+		breakpoint_type_strings[breakpoint->type],
+		breakpoint->asid, breakpoint->length,
+		breakpoint->unique_id);
 
 	return ERROR_OK;
 }
@@ -150,12 +341,17 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
+	struct breakpoint_index *index = breakpoint_index_get(target);
+	struct breakpoint *breakpoint;
 	int retval;
 
-	while (breakpoint) {
-		if ((breakpoint->asid == asid) && (breakpoint->address == address)) {
+	if (!index)
+		return ERROR_FAIL;
+
+	for (unsigned int pos = breakpoint_index_lower(index, address);
+			pos < index->count && index->sorted[pos]->address == address; pos++) {
+		breakpoint = index->sorted[pos];
+		if (breakpoint->asid == asid) {
 			/* FIXME don't assume "same address" means "same
 			 * breakpoint" ... check all the parameters before
 			 * succeeding.
@@ -163,40 +359,35 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 			LOG_ERROR("Duplicate Hybrid Breakpoint asid: 0x%08" PRIx32 " (BP %" PRIu32 ")",
 				asid, breakpoint->unique_id);
 			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
-		} else if ((breakpoint->address == address) && (breakpoint->asid == 0)) {
+		} else if (breakpoint->asid == 0) {
 			LOG_ERROR("Duplicate Breakpoint IVA: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
 				address, breakpoint->unique_id);
 			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 
 		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
 	}
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = address;
-	(*breakpoint_p)->asid = asid;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->is_set = false;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
 
+	breakpoint = breakpoint_new(address, asid, length, type);
+	if (!breakpoint || breakpoint_link(target, breakpoint) != ERROR_OK) {
+		LOG_ERROR("Out of memory");
+		if (breakpoint)
+			free(breakpoint->orig_instr);
+		free(breakpoint);
+		return ERROR_FAIL;
+	}
 
-	retval = target_add_hybrid_breakpoint(target, *breakpoint_p);
+	retval = target_add_hybrid_breakpoint(target, breakpoint);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("could not add breakpoint");
-		free((*breakpoint_p)->orig_instr);
-		free(*breakpoint_p);
-		*breakpoint_p = NULL;
+		breakpoint_delete(target, breakpoint);
 		return retval;
 	}
 	LOG_DEBUG(
 		"added %s Hybrid breakpoint at address " TARGET_ADDR_FMT " of length 0x%8.8x, (BPID: %" PRIu32 ")",
-		breakpoint_type_strings[(*breakpoint_p)->type],
-		(*breakpoint_p)->address,
-		(*breakpoint_p)->length,
-		(*breakpoint_p)->unique_id);
+		breakpoint_type_strings[breakpoint->type],
+		breakpoint->address,
+		breakpoint->length,
+		breakpoint->unique_id);
 
 	return ERROR_OK;
 }
@@ -270,40 +461,38 @@ int hybrid_breakpoint_add(struct target *target,
 }
 
 /* free up a breakpoint */
-static void breakpoint_free(struct target *target, struct breakpoint *breakpoint_to_remove)
+static void breakpoint_free(struct target *target, struct breakpoint *breakpoint)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
-	int retval;
-
-	while (breakpoint) {
-		if (breakpoint == breakpoint_to_remove)
-			break;
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
-	}
+	int retval = target_remove_breakpoint(target, breakpoint);
 
-	if (!breakpoint)
-		return;
+	LOG_DEBUG("free BPID: %" PRIu32 " --> %d", breakpoint->unique_id, retval);
+	breakpoint_delete(target, breakpoint);
+}
 
-	retval = target_remove_breakpoint(target, breakpoint);
+/* the breakpoint removed by breakpoint_remove() for address */
+static struct breakpoint *breakpoint_remove_find(struct target *target,
+	target_addr_t address)
+{
+	struct breakpoint *breakpoint = breakpoint_find(target, address);
+	struct breakpoint_index *index = target->breakpoint_index;
+
+	/* context breakpoints are at address 0 and removed by asid */
+	for (unsigned int pos = 0; index && pos < index->count &&
+			index->sorted[pos]->address == 0; pos++) {
+		struct breakpoint *context = index->sorted[pos];
+		if (context->asid != address)
+			continue;
+		if (!breakpoint || context->unique_id < breakpoint->unique_id)
+			breakpoint = context;
+		break;
+	}
 
-	LOG_DEBUG("free BPID: %" PRIu32 " --> %d", breakpoint->unique_id, retval);
-	(*breakpoint_p) = breakpoint->next;
-	free(breakpoint->orig_instr);
-	free(breakpoint);
+	return breakpoint;
 }
 
 static int breakpoint_remove_internal(struct target *target, target_addr_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-
-	while (breakpoint) {
-		if ((breakpoint->address == address) ||
-		    (breakpoint->address == 0 && breakpoint->asid == address))
-			break;
-		breakpoint = breakpoint->next;
-	}
+	struct breakpoint *breakpoint = breakpoint_remove_find(target, address);
 
 	if (breakpoint) {
 		breakpoint_free(target, breakpoint);
@@ -357,6 +546,211 @@ void breakpoint_remove_all(struct target *target)
 	}
 }
 
+static int breakpoint_reserve(struct target *target, unsigned int count)
+{
+	struct breakpoint_index *index = breakpoint_index_get(target);
+
+	if (!index)
+		return ERROR_FAIL;
+
+	return breakpoint_index_reserve(index, index->count + count);
+}
+
+static int breakpoint_address_cmp(const void *a, const void *b)
+{
+	target_addr_t addr_a = *(const target_addr_t *)a;
+	target_addr_t addr_b = *(const target_addr_t *)b;
+
+	if (addr_a != addr_b)
+		return addr_a < addr_b ? -1 : 1;
+	return 0;
+}
+
+/* breakpoint_add(), leaving no breakpoint on the targets of a SMP group
+ * that took it when another one fails */
+static int breakpoint_add_all_or_none(struct target *target, target_addr_t address,
+	uint32_t length, enum breakpoint_type type)
+{
+	if (!target->smp || type == BKPT_SOFT)
+		return breakpoint_add(target, address, length, type);
+
+	struct target_list *head;
+	foreach_smp_target(head, target->smp_targets) {
+		int retval = breakpoint_add_internal(head->target, address, length, type);
+		if (retval == ERROR_OK)
+			continue;
+
+		struct target_list *done;
+		foreach_smp_target(done, target->smp_targets) {
+			if (done == head)
+				break;
+			/* the breakpoint just added is the last of the list */
+			struct breakpoint_index *index = done->target->breakpoint_index;
+			if (index && index->last && index->last->address == address)
+				breakpoint_free(done->target, index->last);
+		}
+		return retval;
+	}
+
+	return ERROR_OK;
+}
+
+int breakpoint_add_batch(struct target *target, const target_addr_t *addresses,
+	unsigned int count, uint32_t length, enum breakpoint_type type)
+{
+	unsigned int added = 0;
+	int retval = ERROR_OK;
+
+	if (!count)
+		return ERROR_OK;
+
+	target_addr_t *sorted = malloc(count * sizeof(*sorted));
+	if (!sorted) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	memcpy(sorted, addresses, count * sizeof(*sorted));
+	qsort(sorted, count, sizeof(*sorted), breakpoint_address_cmp);
+
+	for (unsigned int i = 1; i < count; i++) {
+		if (sorted[i] == sorted[i - 1]) {
+			LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT, sorted[i]);
+			free(sorted);
+			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
+		}
+	}
+
+	/* grow the indexes once */
+	if (target->smp) {
+		struct target_list *head;
+
+		foreach_smp_target(head, target->smp_targets) {
+			retval = breakpoint_reserve(head->target, count);
+			if (retval != ERROR_OK)
+				break;
+		}
+	} else {
+		retval = breakpoint_reserve(target, count);
+	}
+	if (retval != ERROR_OK) {
+		free(sorted);
+		return retval;
+	}
+
+	/* in address order, consecutive memory accesses of software breakpoints
+	 * are close to each other */
+	for (; added < count; added++) {
+		retval = breakpoint_add_all_or_none(target, sorted[added], length, type);
+		if (retval != ERROR_OK)
+			break;
+	}
+
+	/* all or nothing */
+	if (retval != ERROR_OK)
+		breakpoint_remove_batch(target, sorted, added);
+
+	free(sorted);
+	return retval;
+}
+
+/* order of the breakpoints being freed, not dereferencing them */
+static int breakpoint_pointer_cmp(const void *a, const void *b)
+{
+	uintptr_t bp_a = (uintptr_t)*(struct breakpoint * const *)a;
+	uintptr_t bp_b = (uintptr_t)*(struct breakpoint * const *)b;
+
+	if (bp_a != bp_b)
+		return bp_a < bp_b ? -1 : 1;
+	return 0;
+}
+
+/* remove the breakpoints at the sorted addresses, setting found[] of those
+ * removed */
+static void breakpoint_remove_batch_internal(struct target *target,
+	const target_addr_t *addresses, unsigned int count, bool *found)
+{
+	struct breakpoint **victims = malloc(count * sizeof(*victims));
+	unsigned int num_victims = 0;
+
+	if (!victims) {
+		LOG_ERROR("Out of memory");
+		return;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct breakpoint *breakpoint = breakpoint_remove_find(target, addresses[i]);
+		if (!breakpoint)
+			continue;
+		found[i] = true;
+		victims[num_victims++] = breakpoint;
+	}
+
+	/* a context breakpoint can be picked by its address and by its asid */
+	qsort(victims, num_victims, sizeof(*victims), breakpoint_index_cmp);
+
+	/* the list and the index are left untouched while the target removes
+	 * the breakpoints, in address order */
+	for (unsigned int i = 0; i < num_victims; i++) {
+		if (i && victims[i] == victims[i - 1])
+			continue;
+		int retval = target_remove_breakpoint(target, victims[i]);
+		LOG_DEBUG("free BPID: %" PRIu32 " --> %d", victims[i]->unique_id, retval);
+	}
+
+	/* then a single pass over the list, and the index is rebuilt once */
+	qsort(victims, num_victims, sizeof(*victims), breakpoint_pointer_cmp);
+	struct breakpoint **breakpoint_p = &target->breakpoints;
+	while (*breakpoint_p) {
+		struct breakpoint *breakpoint = *breakpoint_p;
+		if (!bsearch(&breakpoint, victims, num_victims, sizeof(*victims),
+				breakpoint_pointer_cmp)) {
+			breakpoint_p = &breakpoint->next;
+			continue;
+		}
+		*breakpoint_p = breakpoint->next;
+		free(breakpoint->orig_instr);
+		free(breakpoint);
+	}
+	breakpoint_list_changed(target);
+
+	free(victims);
+}
+
+void breakpoint_remove_batch(struct target *target, const target_addr_t *addresses,
+	unsigned int count)
+{
+	if (!count)
+		return;
+
+	target_addr_t *sorted = malloc(count * sizeof(*sorted));
+	bool *found = calloc(count, sizeof(*found));
+	if (!sorted || !found) {
+		LOG_ERROR("Out of memory");
+		free(found);
+		free(sorted);
+		return;
+	}
+	memcpy(sorted, addresses, count * sizeof(*sorted));
+	qsort(sorted, count, sizeof(*sorted), breakpoint_address_cmp);
+
+	if (target->smp) {
+		struct target_list *head;
+
+		foreach_smp_target(head, target->smp_targets)
+			breakpoint_remove_batch_internal(head->target, sorted, count, found);
+	} else {
+		breakpoint_remove_batch_internal(target, sorted, count, found);
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (!found[i])
+			LOG_ERROR("no breakpoint at address " TARGET_ADDR_FMT " found", sorted[i]);
+	}
+
+	free(found);
+	free(sorted);
+}
+
 static void breakpoint_clear_target_internal(struct target *target)
 {
 	LOG_DEBUG("Delete all breakpoints for target: %s",
@@ -381,14 +775,24 @@ void breakpoint_clear_target(struct target *target)
 
 struct breakpoint *breakpoint_find(struct target *target, target_addr_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint_index *index = breakpoint_index_get(target);
 
-	while (breakpoint) {
-		if (breakpoint->address == address)
-			return breakpoint;
-		breakpoint = breakpoint->next;
+	if (!index) {
+		struct breakpoint *breakpoint = target->breakpoints;
+
+		while (breakpoint) {
+			if (breakpoint->address == address)
+				return breakpoint;
+			breakpoint = breakpoint->next;
+		}
+
+		return NULL;
 	}
 
+	unsigned int pos = breakpoint_index_lower(index, address);
+	if (pos < index->count && index->sorted[pos]->address == address)
+		return index->sorted[pos];
+
 	return NULL;
 }
 
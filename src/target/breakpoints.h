@@ -60,6 +60,35 @@ void breakpoint_remove_all(struct target *target);
 
 struct breakpoint *breakpoint_find(struct target *target, target_addr_t address);
 
+/**
+ * Add breakpoints at all the addresses, in address order, or none of them.
+ * The index of each target is grown once for the whole set.
+ */
+int breakpoint_add_batch(struct target *target, const target_addr_t *addresses,
+		unsigned int count, uint32_t length, enum breakpoint_type type);
+/**
+ * Remove the breakpoints at the addresses, in address order. The list of
+ * each target is walked and its index rebuilt once for the whole set.
+ */
+void breakpoint_remove_batch(struct target *target, const target_addr_t *addresses,
+		unsigned int count);
+
+/**
+ * Breakpoints of a target sorted by address, for breakpoint_find().
+ * Code freeing breakpoints of target->breakpoints without the functions
+ * above must call breakpoint_list_changed().
+ */
+struct breakpoint_index {
+	struct breakpoint **sorted;
+	unsigned int count;
+	unsigned int size;
+	/* tail of target->breakpoints, where new breakpoints are added */
+	struct breakpoint *last;
+};
+
+void breakpoint_list_changed(struct target *target);
+void breakpoint_index_free(struct target *target);
+
 static inline void breakpoint_hw_set(struct breakpoint *breakpoint, unsigned int hw_number)
 {
 	breakpoint->is_set = true;
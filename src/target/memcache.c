@@ -0,0 +1,378 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/align.h>
+#include <helper/log.h>
+
+#include "memcache.h"
+#include "smp.h"
+#include "target.h"
+#include "target_type.h"
+
+#define MEMCACHE_DEFAULT_PAGE_SIZE	256
+#define MEMCACHE_DEFAULT_NUM_PAGES	256
+
+struct memcache_range {
+	target_addr_t address;
+	uint64_t size;
+};
+
+struct memcache_page {
+	target_addr_t address;
+	/* the page is valid if it matches the generation of the cache */
+	uint32_t generation;
+};
+
+struct target_memcache {
+	bool enabled;
+	/* both are powers of 2 */
+	unsigned int page_size;
+	unsigned int num_pages;
+	struct memcache_page *pages;
+	uint8_t *data;
+	/* incremented to invalidate all the pages at once */
+	uint32_t generation;
+
+	struct memcache_range *volatile_ranges;
+	unsigned int num_volatile_ranges;
+
+	/* statistics */
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t bypassed;
+	uint64_t invalidations;
+};
+
+bool target_memcache_enabled(struct target *target)
+{
+	return target->memcache && target->memcache->enabled;
+}
+
+static bool memcache_is_volatile(struct target_memcache *cache,
+		target_addr_t address, uint64_t len)
+{
+	for (unsigned int i = 0; i < cache->num_volatile_ranges; i++) {
+		struct memcache_range *r = &cache->volatile_ranges[i];
+		if (address <= r->address + (r->size - 1) && r->address <= address + (len - 1))
+			return true;
+	}
+
+	return false;
+}
+
+int target_memcache_read(struct target *target, target_addr_t address,
+		uint32_t size, uint32_t count, uint8_t *buffer)
+{
+	struct target_memcache *cache = target->memcache;
+	uint64_t len = (uint64_t)size * count;
+	uint64_t capacity = (uint64_t)cache->page_size * cache->num_pages;
+
+	target_addr_t page_mask = cache->page_size - 1;
+	target_addr_t page_address = address & ~page_mask;
+	target_addr_t end = address + (len - 1);
+
+	/* Memory can change under a running target or algorithm. Large reads
+	 * would just evict the cached stack and data pages. A miss reads whole
+	 * pages, which must not touch a volatile range next to the request. */
+	if (target->state != TARGET_HALTED || target->running_alg || !len ||
+			len > capacity / 4 || end < address ||
+			size > cache->page_size ||
+			memcache_is_volatile(cache, page_address,
+				(end | page_mask) - page_address + 1)) {
+		cache->bypassed++;
+		return target->type->read_memory(target, address, size, count, buffer);
+	}
+
+	while (true) {
+		unsigned int slot = (page_address / cache->page_size) & (cache->num_pages - 1);
+		struct memcache_page *page = &cache->pages[slot];
+		uint8_t *data = cache->data + (size_t)slot * cache->page_size;
+
+		if (page->generation != cache->generation || page->address != page_address) {
+			int retval = target->type->read_memory(target, page_address, size,
+					cache->page_size / size, data);
+			if (retval != ERROR_OK) {
+				/* e.g. the page extends beyond the end of the memory */
+				page->generation = cache->generation - 1;
+				cache->bypassed++;
+				return target->type->read_memory(target, address, size, count, buffer);
+			}
+			page->address = page_address;
+			page->generation = cache->generation;
+			cache->misses++;
+		} else {
+			cache->hits++;
+		}
+
+		target_addr_t from = MAX(address, page_address);
+		target_addr_t to = MIN(end, page_address + page_mask);
+		memcpy(buffer + (from - address), data + (from - page_address), to - from + 1);
+
+		if (to == end)
+			break;
+		page_address += cache->page_size;
+	}
+
+	return ERROR_OK;
+}
+
+static void memcache_invalidate_one(struct target *target)
+{
+	struct target_memcache *cache = target->memcache;
+
+	if (!cache || !cache->enabled)
+		return;
+
+	cache->generation++;
+	cache->invalidations++;
+}
+
+void target_memcache_invalidate(struct target *target)
+{
+	if (!target->smp) {
+		memcache_invalidate_one(target);
+		return;
+	}
+
+	/* the targets of a SMP group share the memory */
+	struct target_list *head;
+	foreach_smp_target(head, target->smp_targets)
+		memcache_invalidate_one(head->target);
+}
+
+static void memcache_free_pages(struct target_memcache *cache)
+{
+	free(cache->pages);
+	cache->pages = NULL;
+	free(cache->data);
+	cache->data = NULL;
+}
+
+void target_memcache_free(struct target *target)
+{
+	struct target_memcache *cache = target->memcache;
+
+	if (!cache)
+		return;
+
+	memcache_free_pages(cache);
+	free(cache->volatile_ranges);
+	free(cache);
+	target->memcache = NULL;
+}
+
+static struct target_memcache *memcache_get(struct target *target)
+{
+	if (!target->memcache) {
+		target->memcache = calloc(1, sizeof(struct target_memcache));
+		if (!target->memcache)
+			LOG_ERROR("Out of memory");
+	}
+
+	return target->memcache;
+}
+
+COMMAND_HANDLER(handle_memcache_enable_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	unsigned int page_size = MEMCACHE_DEFAULT_PAGE_SIZE;
+	unsigned int num_pages = MEMCACHE_DEFAULT_NUM_PAGES;
+
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC > 0)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], page_size);
+	if (CMD_ARGC > 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], num_pages);
+
+	if (page_size < 8 || !IS_PWR_OF_2(page_size) || !num_pages ||
+			!IS_PWR_OF_2(num_pages)) {
+		command_print(CMD, "page size (at least 8) and number of pages must be powers of 2");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct target_memcache *cache = memcache_get(target);
+	if (!cache)
+		return ERROR_FAIL;
+
+	memcache_free_pages(cache);
+	cache->pages = calloc(num_pages, sizeof(*cache->pages));
+	cache->data = malloc((size_t)page_size * num_pages);
+	if (!cache->pages || !cache->data) {
+		memcache_free_pages(cache);
+		cache->enabled = false;
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	cache->page_size = page_size;
+	cache->num_pages = num_pages;
+	/* pages start at generation 0, hence invalid */
+	cache->generation = 1;
+	cache->enabled = true;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memcache_disable_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	struct target_memcache *cache = target->memcache;
+
+	if (cache) {
+		memcache_free_pages(cache);
+		cache->enabled = false;
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memcache_invalidate_command)
+{
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	target_memcache_invalidate(get_current_target(CMD_CTX));
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memcache_volatile_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct target_memcache *cache = memcache_get(target);
+
+	if (!cache)
+		return ERROR_FAIL;
+
+	switch (CMD_ARGC) {
+	case 0:
+		for (unsigned int i = 0; i < cache->num_volatile_ranges; i++)
+			command_print(CMD, "volatile: " TARGET_ADDR_FMT " size 0x%" PRIx64,
+					cache->volatile_ranges[i].address,
+					cache->volatile_ranges[i].size);
+		return ERROR_OK;
+	case 1:
+		if (strcmp(CMD_ARGV[0], "clear"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		free(cache->volatile_ranges);
+		cache->volatile_ranges = NULL;
+		cache->num_volatile_ranges = 0;
+		return ERROR_OK;
+	case 2:
+		break;
+	default:
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	struct memcache_range range;
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], range.address);
+	COMMAND_PARSE_NUMBER(u64, CMD_ARGV[1], range.size);
+	if (!range.size)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	struct memcache_range *ranges = realloc(cache->volatile_ranges,
+			(cache->num_volatile_ranges + 1) * sizeof(*ranges));
+	if (!ranges) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	ranges[cache->num_volatile_ranges++] = range;
+	cache->volatile_ranges = ranges;
+
+	/* a page of the new range could be cached already */
+	target_memcache_invalidate(target);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_memcache_stats_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct target_memcache *cache = target->memcache;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		if (cache) {
+			cache->hits = 0;
+			cache->misses = 0;
+			cache->bypassed = 0;
+			cache->invalidations = 0;
+		}
+		return ERROR_OK;
+	}
+
+	if (!target_memcache_enabled(target)) {
+		command_print(CMD, "memory cache of %s is disabled", target_name(target));
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "memory cache of %s: %u pages of %u bytes",
+			target_name(target), cache->num_pages, cache->page_size);
+	command_print(CMD, "page hits: %" PRIu64 ", page misses: %" PRIu64
+			", uncached reads: %" PRIu64 ", invalidations: %" PRIu64,
+			cache->hits, cache->misses, cache->bypassed, cache->invalidations);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration memcache_subcommand_handlers[] = {
+	{
+		.name = "enable",
+		.handler = handle_memcache_enable_command,
+		.mode = COMMAND_ANY,
+		.help = "enable the memory read cache, emptying it",
+		.usage = "[page_size [num_pages]]",
+	},
+	{
+		.name = "disable",
+		.handler = handle_memcache_disable_command,
+		.mode = COMMAND_ANY,
+		.help = "disable the memory read cache",
+		.usage = "",
+	},
+	{
+		.name = "invalidate",
+		.handler = handle_memcache_invalidate_command,
+		.mode = COMMAND_ANY,
+		.help = "invalidate the memory read cache",
+		.usage = "",
+	},
+	{
+		.name = "volatile",
+		.handler = handle_memcache_volatile_command,
+		.mode = COMMAND_ANY,
+		.help = "add a memory range that is never cached, "
+			"list or clear the ranges",
+		.usage = "[address size | 'clear']",
+	},
+	{
+		.name = "stats",
+		.handler = handle_memcache_stats_command,
+		.mode = COMMAND_ANY,
+		.help = "show or reset the memory read cache statistics",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct command_registration target_memcache_command_handlers[] = {
+	{
+		.name = "memcache",
+		.mode = COMMAND_ANY,
+		.help = "memory read cache commands",
+		.chain = memcache_subcommand_handlers,
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_MEMCACHE_H
+#define OPENOCD_TARGET_MEMCACHE_H
+
+#include <helper/command.h>
+#include <helper/types.h>
+
+struct target;
+
+/**
+ * @file
+ * Optional per-target cache of memory reads.
+ *
+ * While the target is halted, memory read through target_read_memory() is
+ * kept in a direct-mapped cache of pages, so that the same stack and data
+ * regions read several times by GDB on each stop go to the adapter only once.
+ * The whole cache is invalidated on any memory write, on resume, step and
+ * reset, after running an algorithm, and when the target halts.
+ * Reads whose pages overlap a volatile range (e.g. peripherals) are never
+ * cached.
+ */
+
+/** @returns true if reads of @a target go through its memory cache. */
+bool target_memcache_enabled(struct target *target);
+
+/** Read target memory through the cache, see target_read_memory(). */
+int target_memcache_read(struct target *target, target_addr_t address,
+		uint32_t size, uint32_t count, uint8_t *buffer);
+
+/** Invalidate the cache of @a target and of the rest of its SMP group. */
+void target_memcache_invalidate(struct target *target);
+
+void target_memcache_free(struct target *target);
+
+extern const struct command_registration target_memcache_command_handlers[];
+
+#endif /* OPENOCD_TARGET_MEMCACHE_H */
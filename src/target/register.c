@@ -13,8 +13,12 @@
 #endif
 
 #include "register.h"
+#include <helper/list.h>
 #include <helper/log.h>
 
+/* bumped when a register cache is added or removed, see register_cache_changed() */
+static unsigned int register_caches_generation;
+
 /**
  * @file
  * Holds utilities to work with register caches.
@@ -25,9 +29,197 @@
  * may be separate registers associated with debug or trace modules.
  */
 
+/* below this number of registers, a linear search is fast enough */
+#define REG_INDEX_MIN_REGS 64
+
+/*
+ * Hash index of the registers of a chain of caches, by name and by number.
+ * Both tables use linear probing, so registers with the same name or number
+ * are found in the order of the chain, like the linear search does.
+ * The index is rebuilt when the chain is changed, see register_cache_changed(),
+ * or no longer matches its signature, e.g. the first cache was reallocated.
+ */
+struct reg_index {
+	const struct reg_cache *first;
+	unsigned int generation;
+	/* signature of the indexed chain */
+	unsigned int num_caches;
+	unsigned int num_regs;
+	uintptr_t reg_lists;
+
+	unsigned int mask;
+	struct reg **by_name;
+	struct reg **by_number;
+	struct list_head lh;
+};
+
+static LIST_HEAD(reg_indexes);
+
+static uint32_t reg_name_hash(const char *name)
+{
+	/* FNV-1a */
+	uint32_t hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static uint32_t reg_number_hash(uint32_t number)
+{
+	return number * 2654435761u;
+}
+
+static void reg_chain_signature(const struct reg_cache *first, unsigned int *num_caches,
+		unsigned int *num_regs, uintptr_t *reg_lists)
+{
+	*num_caches = 0;
+	*num_regs = 0;
+	*reg_lists = 0;
+
+	for (const struct reg_cache *cache = first; cache; cache = cache->next) {
+		(*num_caches)++;
+		*num_regs += cache->num_regs;
+		*reg_lists = *reg_lists * 31 + (uintptr_t)cache->reg_list;
+	}
+}
+
+static void reg_index_free(struct reg_index *index)
+{
+	list_del(&index->lh);
+	free(index->by_name);
+	free(index->by_number);
+	free(index);
+}
+
+static int reg_index_build(struct reg_index *index, const struct reg_cache *first)
+{
+	unsigned int size = 1;
+
+	while (size < 2 * index->num_regs)
+		size *= 2;
+
+	free(index->by_name);
+	free(index->by_number);
+	index->by_name = calloc(size, sizeof(struct reg *));
+	index->by_number = calloc(size, sizeof(struct reg *));
+	if (!index->by_name || !index->by_number)
+		return ERROR_FAIL;
+	index->mask = size - 1;
+
+	for (const struct reg_cache *cache = first; cache; cache = cache->next) {
+		for (unsigned int i = 0; i < cache->num_regs; i++) {
+			struct reg *reg = &cache->reg_list[i];
+			uint32_t slot;
+
+			if (reg->name) {
+				slot = reg_name_hash(reg->name) & index->mask;
+				while (index->by_name[slot])
+					slot = (slot + 1) & index->mask;
+				index->by_name[slot] = reg;
+			}
+
+			slot = reg_number_hash(reg->number) & index->mask;
+			while (index->by_number[slot])
+				slot = (slot + 1) & index->mask;
+			index->by_number[slot] = reg;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+/* @returns the up to date index of the chain starting at first, or NULL if
+ * the chain is better searched linearly */
+static struct reg_index *reg_index_get(const struct reg_cache *first)
+{
+	struct reg_index *index;
+	bool found = false;
+	unsigned int num_caches, num_regs;
+	uintptr_t reg_lists;
+
+	if (!first)
+		return NULL;
+
+	list_for_each_entry(index, &reg_indexes, lh) {
+		if (index->first == first) {
+			found = true;
+			break;
+		}
+	}
+
+	reg_chain_signature(first, &num_caches, &num_regs, &reg_lists);
+
+	if (found && index->generation == register_cache_generation() &&
+			index->num_caches == num_caches && index->num_regs == num_regs &&
+			index->reg_lists == reg_lists)
+		return index;
+
+	if (num_regs < REG_INDEX_MIN_REGS) {
+		if (found)
+			reg_index_free(index);
+		return NULL;
+	}
+
+	if (!found) {
+		index = calloc(1, sizeof(*index));
+		if (!index)
+			return NULL;
+		index->first = first;
+		list_add(&index->lh, &reg_indexes);
+	}
+
+	index->generation = register_cache_generation();
+	index->num_caches = num_caches;
+	index->num_regs = num_regs;
+	index->reg_lists = reg_lists;
+	if (reg_index_build(index, first) != ERROR_OK) {
+		LOG_ERROR("Out of memory");
+		reg_index_free(index);
+		return NULL;
+	}
+
+	return index;
+}
+
+static bool reg_in_cache(const struct reg_cache *cache, const struct reg *reg)
+{
+	return reg >= cache->reg_list && reg < cache->reg_list + cache->num_regs;
+}
+
+void register_cache_index_free(struct reg_cache *first)
+{
+	struct reg_index *index, *tmp;
+
+	list_for_each_entry_safe(index, tmp, &reg_indexes, lh) {
+		if (index->first == first)
+			reg_index_free(index);
+	}
+}
+
 struct reg *register_get_by_number(struct reg_cache *first,
 		uint32_t reg_num, bool search_all)
 {
+	struct reg_index *index = reg_index_get(first);
+
+	if (index) {
+		uint32_t slot = reg_number_hash(reg_num) & index->mask;
+
+		for (; index->by_number[slot]; slot = (slot + 1) & index->mask) {
+			struct reg *reg = index->by_number[slot];
+			if (!reg->exist || reg->number != reg_num)
+				continue;
+			if (!search_all && !reg_in_cache(first, reg))
+				return NULL;
+			return reg;
+		}
+
+		return NULL;
+	}
+
 	struct reg_cache *cache = first;
 
 	while (cache) {
@@ -50,6 +242,23 @@ struct reg *register_get_by_number(struct reg_cache *first,
 struct reg *register_get_by_name(struct reg_cache *first,
 		const char *name, bool search_all)
 {
+	struct reg_index *index = reg_index_get(first);
+
+	if (index) {
+		uint32_t slot = reg_name_hash(name) & index->mask;
+
+		for (; index->by_name[slot]; slot = (slot + 1) & index->mask) {
+			struct reg *reg = index->by_name[slot];
+			if (!reg->exist || strcmp(reg->name, name) != 0)
+				continue;
+			if (!search_all && !reg_in_cache(first, reg))
+				return NULL;
+			return reg;
+		}
+
+		return NULL;
+	}
+
 	struct reg_cache *cache = first;
 
 	while (cache) {
@@ -84,12 +293,23 @@ struct reg_cache **register_get_last_cache_p(struct reg_cache **first)
 
 void register_unlink_cache(struct reg_cache **cache_p, const struct reg_cache *cache)
 {
+	register_cache_changed();
 	while (*cache_p && *cache_p != cache)
 		cache_p = &((*cache_p)->next);
 	if (*cache_p)
 		*cache_p = cache->next;
 }
 
+void register_cache_changed(void)
+{
+	register_caches_generation++;
+}
+
+unsigned int register_cache_generation(void)
+{
+	return register_caches_generation;
+}
+
 /** Marks the contents of the register cache as invalid (and clean). */
 void register_cache_invalidate(struct reg_cache *cache)
 {
@@ -161,6 +161,22 @@ struct reg_cache **register_get_last_cache_p(struct reg_cache **first);
 void register_unlink_cache(struct reg_cache **cache_p, const struct reg_cache *cache);
 void register_cache_invalidate(struct reg_cache *cache);
 
+/**
+ * Record that the set of registers of some target changed: a cache was
+ * added or removed, or registers were made to exist or hidden.
+ * Data derived from the register lists, like the GDB target description,
+ * is regenerated when register_cache_generation() changes.
+ */
+void register_cache_changed(void);
+unsigned int register_cache_generation(void);
+
+/**
+ * Free the lookup index of the chain of caches starting at @a first,
+ * before the caches are freed. The index is built by register_get_by_name()
+ * and register_get_by_number() for chains with many registers.
+ */
+void register_cache_index_free(struct reg_cache *first);
+
 void register_init_dummy(struct reg *reg);
 
 #endif /* OPENOCD_TARGET_REGISTER_H */
@@ -2074,6 +2074,143 @@ static int riscv_checksum_memory(struct target *target,
 	return retval;
 }
 
+static int riscv_blank_check_memory(struct target *target,
+		struct target_memory_check_block *blocks, int num_blocks,
+		uint8_t erased_value)
+{
+	struct working_area *erase_check_algorithm;
+	struct working_area *erase_check_params;
+	struct reg_param reg_params[2];
+	int retval;
+
+	static const uint8_t riscv32_erase_check_code[] = {
+#include "../../../contrib/loaders/erase_check/riscv32_erase_check.inc"
+	};
+	static const uint8_t riscv64_erase_check_code[] = {
+#include "../../../contrib/loaders/erase_check/riscv64_erase_check.inc"
+	};
+
+	unsigned int xlen = riscv_xlen(target);
+	const uint8_t *code = xlen == 32 ? riscv32_erase_check_code : riscv64_erase_check_code;
+	uint32_t code_size = xlen == 32 ? sizeof(riscv32_erase_check_code) :
+		sizeof(riscv64_erase_check_code);
+
+	/* the algorithm checks whole words, a zero size ends the array */
+	int blocks_to_check = 0;
+	while (blocks_to_check < num_blocks && blocks[blocks_to_check].size &&
+			!(blocks[blocks_to_check].size % 4) &&
+			!(blocks[blocks_to_check].address % 4))
+		blocks_to_check++;
+	if (!blocks_to_check)
+		return ERROR_FAIL;
+
+	if (target_alloc_working_area(target, code_size,
+			&erase_check_algorithm) != ERROR_OK)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	retval = target_write_buffer(target, erase_check_algorithm->address,
+			code_size, code);
+	if (retval != ERROR_OK)
+		goto cleanup1;
+
+	/* struct { xlen size_in_result_out, xlen addr } */
+	unsigned int xlen_bytes = xlen / 8;
+	unsigned int block_size = 2 * xlen_bytes;
+
+	uint32_t avail_blocks = target_get_working_area_avail(target) / block_size;
+	if (avail_blocks < 2) {
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto cleanup1;
+	}
+	if ((uint32_t)blocks_to_check > avail_blocks - 1)
+		blocks_to_check = avail_blocks - 1;
+
+	uint32_t param_size = (blocks_to_check + 1) * block_size;
+	uint8_t *params = calloc(1, param_size);
+	if (!params) {
+		retval = ERROR_FAIL;
+		goto cleanup1;
+	}
+
+	uint64_t total_size = 0;
+	for (int i = 0; i < blocks_to_check; i++) {
+		uint8_t *block = params + i * block_size;
+		total_size += blocks[i].size;
+		if (xlen == 32) {
+			target_buffer_set_u32(target, block, blocks[i].size / 4);
+			target_buffer_set_u32(target, block + xlen_bytes, blocks[i].address);
+		} else {
+			target_buffer_set_u64(target, block, blocks[i].size / 4);
+			target_buffer_set_u64(target, block + xlen_bytes, blocks[i].address);
+		}
+	}
+
+	if (target_alloc_working_area(target, param_size,
+			&erase_check_params) != ERROR_OK) {
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto cleanup2;
+	}
+
+	retval = target_write_buffer(target, erase_check_params->address,
+			param_size, params);
+	if (retval != ERROR_OK)
+		goto cleanup3;
+
+	/* lw sign extends the word read on RV64 */
+	int32_t erased_word = erased_value | (erased_value << 8)
+			| (erased_value << 16) | ((uint32_t)erased_value << 24);
+
+	LOG_DEBUG("Starting erase check of %d blocks, parameters@"
+			TARGET_ADDR_FMT, blocks_to_check, erase_check_params->address);
+
+	init_reg_param(&reg_params[0], "a0", xlen, PARAM_OUT);
+	buf_set_u64(reg_params[0].value, 0, xlen, erase_check_params->address);
+
+	init_reg_param(&reg_params[1], "a1", xlen, PARAM_OUT);
+	buf_set_u64(reg_params[1].value, 0, xlen, (int64_t)erased_word);
+
+	/* assume CPU clk at least 1 MHz */
+	unsigned int timeout = 2000 + total_size * 3 / 1000;
+
+	retval = target_run_algorithm(target, 0, NULL,
+			ARRAY_SIZE(reg_params), reg_params,
+			erase_check_algorithm->address,
+			erase_check_algorithm->address + (code_size - 4),
+			timeout, NULL);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("error executing RISC-V erase check algorithm");
+		goto cleanup4;
+	}
+
+	retval = target_read_buffer(target, erase_check_params->address,
+			param_size, params);
+	if (retval != ERROR_OK)
+		goto cleanup4;
+
+	int i;
+	for (i = 0; i < blocks_to_check; i++) {
+		uint32_t result = target_buffer_get_u32(target, params + i * block_size);
+		if (result != 0 && result != 1)
+			break;
+
+		blocks[i].result = result;
+	}
+
+	retval = i;		/* return number of blocks really checked */
+
+cleanup4:
+	destroy_reg_param(&reg_params[0]);
+	destroy_reg_param(&reg_params[1]);
+cleanup3:
+	target_free_working_area(target, erase_check_params);
+cleanup2:
+	free(params);
+cleanup1:
+	target_free_working_area(target, erase_check_algorithm);
+
+	return retval;
+}
+
 /*** OpenOCD Helper Functions ***/
 
 enum riscv_poll_hart {
@@ -3089,6 +3226,7 @@ struct target_type riscv_target = {
 	.write_phys_memory = riscv_write_phys_memory,
 
 	.checksum_memory = riscv_checksum_memory,
+	.blank_check_memory = riscv_blank_check_memory,
 
 	.mmu = riscv_mmu,
 	.virt2phys = riscv_virt2phys,
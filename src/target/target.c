@@ -43,6 +43,7 @@
 #include "register.h"
 #include "trace.h"
 #include "image.h"
+#include "memcache.h"
 #include "rtos/rtos.h"
 #include "transport/transport.h"
 #include "arm_cti.h"
@@ -61,6 +62,7 @@ static int target_array2mem(Jim_Interp *interp, struct target *target,
 static int target_mem2array(Jim_Interp *interp, struct target *target,
 		int argc, Jim_Obj * const *argv);
 static int target_register_user_commands(struct command_context *cmd_ctx);
+static void free_fastload(void);
 static int target_get_gdb_fileio_info_default(struct target *target,
 		struct gdb_fileio_info *fileio_info);
 static int target_gdb_fileio_end_default(struct target *target, int retcode,
@@ -112,6 +114,14 @@ struct target *all_targets;
 static struct target_event_callback *target_event_callbacks;
 static struct target_timer_callback *target_timer_callbacks;
 static int64_t target_timer_next_event_value;
+/* min-heap of the registered timer callbacks, ordered by deadline */
+static struct target_timer_callback **target_timer_heap;
+static unsigned int target_timer_heap_len;
+static unsigned int target_timer_heap_size;
+/* callbacks collected for the current invocation pass */
+static struct target_timer_callback **target_timer_due;
+/* unregistered callbacks still to be freed */
+static unsigned int target_timer_removed_count;
 static LIST_HEAD(target_reset_callback_list);
 static LIST_HEAD(target_trace_callback_list);
 static const int polling_interval = TARGET_DEFAULT_POLLING_INTERVAL;
@@ -618,6 +628,8 @@ int target_resume(struct target *target, int current, target_addr_t address,
 	 * Disable polling during resume() to guarantee the execution of handlers
 	 * in the correct order.
 	 */
+	target_memcache_invalidate(target);
+
 	bool save_poll_mask = jtag_poll_mask();
 	retval = target->type->resume(target, current, address, handle_breakpoints, debug_execution);
 	jtag_poll_unmask(save_poll_mask);
@@ -714,6 +726,8 @@ int target_examine_one(struct target *target)
 	target_call_event_callbacks(target, TARGET_EVENT_EXAMINE_START);
 
 	int retval = target->type->examine(target);
+	/* examine can discover the registers */
+	register_cache_changed();
 	if (retval != ERROR_OK) {
 		target_reset_examined(target);
 		target_call_event_callbacks(target, TARGET_EVENT_EXAMINE_FAIL);
@@ -829,6 +843,7 @@ int target_run_algorithm(struct target *target,
 			num_reg_params, reg_param,
 			entry_point, exit_point, timeout_ms, arch_info);
 	target->running_alg = false;
+	target_memcache_invalidate(target);
 
 done:
 	return retval;
@@ -868,6 +883,7 @@ int target_start_algorithm(struct target *target,
 		goto done;
 	}
 
+	target_memcache_invalidate(target);
 	target->running_alg = true;
 	retval = target->type->start_algorithm(target,
 			num_mem_params, mem_params,
@@ -914,6 +930,7 @@ int target_wait_algorithm(struct target *target,
 			exit_point, timeout_ms, arch_info);
 	if (retval != ERROR_TARGET_TIMEOUT)
 		target->running_alg = false;
+	target_memcache_invalidate(target);
 
 done:
 	return retval;
@@ -1276,6 +1293,8 @@ int target_read_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support read_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	if (target_memcache_enabled(target))
+		return target_memcache_read(target, address, size, count, buffer);
 	return target->type->read_memory(target, address, size, count, buffer);
 }
 
@@ -1304,6 +1323,8 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	/* a write can have side effects anywhere, e.g. to a flash controller */
+	target_memcache_invalidate(target);
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
@@ -1318,6 +1339,7 @@ int target_write_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	target_memcache_invalidate(target);
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1328,6 +1350,7 @@ int target_add_breakpoint(struct target *target,
 		LOG_WARNING("target %s is not halted (add breakpoint)", target_name(target));
 		return ERROR_TARGET_NOT_HALTED;
 	}
+	target_memcache_invalidate(target);
 	return target->type->add_breakpoint(target, breakpoint);
 }
 
@@ -1338,6 +1361,7 @@ int target_add_context_breakpoint(struct target *target,
 		LOG_WARNING("target %s is not halted (add context breakpoint)", target_name(target));
 		return ERROR_TARGET_NOT_HALTED;
 	}
+	target_memcache_invalidate(target);
 	return target->type->add_context_breakpoint(target, breakpoint);
 }
 
@@ -1348,12 +1372,14 @@ int target_add_hybrid_breakpoint(struct target *target,
 		LOG_WARNING("target %s is not halted (add hybrid breakpoint)", target_name(target));
 		return ERROR_TARGET_NOT_HALTED;
 	}
+	target_memcache_invalidate(target);
 	return target->type->add_hybrid_breakpoint(target, breakpoint);
 }
 
 int target_remove_breakpoint(struct target *target,
 		struct breakpoint *breakpoint)
 {
+	target_memcache_invalidate(target);
 	return target->type->remove_breakpoint(target, breakpoint);
 }
 
@@ -1445,6 +1471,7 @@ int target_step(struct target *target,
 
 	target_call_event_callbacks(target, TARGET_EVENT_STEP_START);
 
+	target_memcache_invalidate(target);
 	retval = target->type->step(target, current, address, handle_breakpoints);
 	if (retval != ERROR_OK)
 		return retval;
@@ -1686,6 +1713,89 @@ int target_register_trace_callback(int (*callback)(struct target *target,
 	return ERROR_OK;
 }
 
+#define TARGET_TIMER_NOT_QUEUED	UINT_MAX
+
+static void target_timer_heap_set(unsigned int index, struct target_timer_callback *cb)
+{
+	target_timer_heap[index] = cb;
+	cb->heap_index = index;
+}
+
+static void target_timer_heap_sift_up(unsigned int index)
+{
+	struct target_timer_callback *cb = target_timer_heap[index];
+
+	while (index > 0) {
+		unsigned int parent = (index - 1) / 2;
+		if (target_timer_heap[parent]->when <= cb->when)
+			break;
+		target_timer_heap_set(index, target_timer_heap[parent]);
+		index = parent;
+	}
+	target_timer_heap_set(index, cb);
+}
+
+static void target_timer_heap_sift_down(unsigned int index)
+{
+	struct target_timer_callback *cb = target_timer_heap[index];
+
+	while (true) {
+		unsigned int child = 2 * index + 1;
+		if (child >= target_timer_heap_len)
+			break;
+		if (child + 1 < target_timer_heap_len &&
+				target_timer_heap[child + 1]->when < target_timer_heap[child]->when)
+			child++;
+		if (cb->when <= target_timer_heap[child]->when)
+			break;
+		target_timer_heap_set(index, target_timer_heap[child]);
+		index = child;
+	}
+	target_timer_heap_set(index, cb);
+}
+
+static int target_timer_heap_push(struct target_timer_callback *cb)
+{
+	if (target_timer_heap_len == target_timer_heap_size) {
+		unsigned int size = target_timer_heap_size ? 2 * target_timer_heap_size : 16;
+		struct target_timer_callback **heap = realloc(target_timer_heap, size * sizeof(*heap));
+		if (!heap)
+			return ERROR_FAIL;
+		target_timer_heap = heap;
+
+		/* every queued callback can be due in the same pass */
+		struct target_timer_callback **due = realloc(target_timer_due, size * sizeof(*due));
+		if (!due)
+			return ERROR_FAIL;
+		target_timer_due = due;
+
+		target_timer_heap_size = size;
+	}
+
+	target_timer_heap_set(target_timer_heap_len++, cb);
+	target_timer_heap_sift_up(cb->heap_index);
+	return ERROR_OK;
+}
+
+static void target_timer_heap_remove(struct target_timer_callback *cb)
+{
+	unsigned int index = cb->heap_index;
+
+	if (index == TARGET_TIMER_NOT_QUEUED)
+		return;
+	cb->heap_index = TARGET_TIMER_NOT_QUEUED;
+
+	target_timer_heap_len--;
+	if (index == target_timer_heap_len)
+		return;
+
+	/* move the last entry into the hole and restore the heap order */
+	struct target_timer_callback *last = target_timer_heap[target_timer_heap_len];
+	target_timer_heap_set(index, last);
+	target_timer_heap_sift_up(index);
+	target_timer_heap_sift_down(last->heap_index);
+}
+
 int target_register_timer_callback(int (*callback)(void *priv),
 		unsigned int time_ms, enum target_timer_type type, void *priv)
 {
@@ -1700,17 +1810,30 @@ int target_register_timer_callback(int (*callback)(void *priv),
 		callbacks_p = &((*callbacks_p)->next);
 	}
 
-	(*callbacks_p) = malloc(sizeof(struct target_timer_callback));
-	(*callbacks_p)->callback = callback;
-	(*callbacks_p)->type = type;
-	(*callbacks_p)->time_ms = time_ms;
-	(*callbacks_p)->removed = false;
+	struct target_timer_callback *cb = calloc(1, sizeof(struct target_timer_callback));
+	if (!cb) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	cb->callback = callback;
+	cb->type = type;
+	cb->time_ms = time_ms;
+	cb->removed = false;
 
-	(*callbacks_p)->when = timeval_ms() + time_ms;
-	target_timer_next_event_value = MIN(target_timer_next_event_value, (*callbacks_p)->when);
+	cb->when = timeval_ms() + time_ms;
+	target_timer_next_event_value = MIN(target_timer_next_event_value, cb->when);
 
-	(*callbacks_p)->priv = priv;
-	(*callbacks_p)->next = NULL;
+	cb->priv = priv;
+	cb->heap_index = TARGET_TIMER_NOT_QUEUED;
+	cb->next = NULL;
+
+	if (target_timer_heap_push(cb) != ERROR_OK) {
+		LOG_ERROR("Out of memory");
+		free(cb);
+		return ERROR_FAIL;
+	}
+
+	*callbacks_p = cb;
 
 	return ERROR_OK;
 }
@@ -1783,8 +1906,10 @@ int target_unregister_timer_callback(int (*callback)(void *priv), void *priv)
 
 	for (struct target_timer_callback *c = target_timer_callbacks;
 	     c; c = c->next) {
-		if ((c->callback == callback) && (c->priv == priv)) {
+		if (c->callback == callback && c->priv == priv && !c->removed) {
 			c->removed = true;
+			target_timer_heap_remove(c);
+			target_timer_removed_count++;
 			return ERROR_OK;
 		}
 	}
@@ -1797,6 +1922,9 @@ int target_call_event_callbacks(struct target *target, enum target_event event)
 	struct target_event_callback *callback = target_event_callbacks;
 	struct target_event_callback *next_callback;
 
+	if (event == TARGET_EVENT_HALTED || event == TARGET_EVENT_RESUMED)
+		target_memcache_invalidate(target);
+
 	if (event == TARGET_EVENT_HALTED) {
 		/* execute early halted first */
 		target_call_event_callbacks(target, TARGET_EVENT_GDB_HALT);
@@ -1824,6 +1952,8 @@ int target_call_reset_callbacks(struct target *target, enum target_reset_mode re
 	LOG_DEBUG("target reset %i (%s)", reset_mode,
 			nvp_value2name(nvp_reset_modes, reset_mode)->name);
 
+	target_memcache_invalidate(target);
+
 	list_for_each_entry(callback, &target_reset_callback_list, list)
 		callback->callback(target, reset_mode, callback->priv);
 
@@ -1844,13 +1974,31 @@ static int target_timer_callback_periodic_restart(
 		struct target_timer_callback *cb, int64_t *now)
 {
 	cb->when = *now + cb->time_ms;
-	return ERROR_OK;
+	return target_timer_heap_push(cb);
 }
 
 static int target_call_timer_callback(struct target_timer_callback *cb,
 		int64_t *now)
 {
+	struct duration run_time;
+
+	/* started a whole period (or more) after the deadline */
+	if (cb->type == TARGET_TIMER_TYPE_PERIODIC && cb->time_ms &&
+			*now - cb->when >= cb->time_ms)
+		cb->overruns++;
+
+	duration_start(&run_time);
 	cb->callback(cb->priv);
+	duration_measure(&run_time);
+
+	uint64_t us = (uint64_t)run_time.elapsed.tv_sec * 1000000 + run_time.elapsed.tv_usec;
+	cb->run_count++;
+	cb->run_time_us += us;
+	cb->max_run_time_us = MAX(cb->max_run_time_us, us);
+
+	/* the callback might have unregistered itself */
+	if (cb->removed)
+		return ERROR_OK;
 
 	if (cb->type == TARGET_TIMER_TYPE_PERIODIC)
 		return target_timer_callback_periodic_restart(cb, now);
@@ -1858,9 +2006,26 @@ static int target_call_timer_callback(struct target_timer_callback *cb,
 	return target_unregister_timer_callback(cb->callback, cb->priv);
 }
 
+static void target_timer_free_removed(void)
+{
+	struct target_timer_callback **callback = &target_timer_callbacks;
+
+	while (target_timer_removed_count && *callback) {
+		if ((*callback)->removed) {
+			struct target_timer_callback *p = *callback;
+			*callback = (*callback)->next;
+			free(p);
+			target_timer_removed_count--;
+			continue;
+		}
+		callback = &(*callback)->next;
+	}
+}
+
 static int target_call_timer_callbacks_check_time(int checktime)
 {
 	static bool callback_processing;
+	unsigned int num_due = 0;
 
 	/* Do not allow nesting */
 	if (callback_processing)
@@ -1872,36 +2037,43 @@ static int target_call_timer_callbacks_check_time(int checktime)
 
 	int64_t now = timeval_ms();
 
-	/* Initialize to a default value that's a ways into the future.
-	 * The loop below will make it closer to now if there are
-	 * callbacks that want to be called sooner. */
-	target_timer_next_event_value = now + 1000;
-
-	/* Store an address of the place containing a pointer to the
-	 * next item; initially, that's a standalone "root of the
-	 * list" variable. */
-	struct target_timer_callback **callback = &target_timer_callbacks;
-	while (callback && *callback) {
-		if ((*callback)->removed) {
-			struct target_timer_callback *p = *callback;
-			*callback = (*callback)->next;
-			free(p);
-			continue;
+	/* Collect the callbacks to invoke first, so that the ones rescheduled or
+	 * registered by a callback are not run again in this pass. */
+	if (checktime) {
+		while (target_timer_heap_len && target_timer_heap[0]->when <= now) {
+			target_timer_due[num_due++] = target_timer_heap[0];
+			target_timer_heap_remove(target_timer_heap[0]);
 		}
+	} else {
+		for (struct target_timer_callback *c = target_timer_callbacks; c; c = c->next) {
+			if (c->removed || (c->type != TARGET_TIMER_TYPE_PERIODIC && now < c->when))
+				continue;
+			target_timer_due[num_due++] = c;
+			target_timer_heap_remove(c);
+		}
+	}
 
-		bool call_it = (*callback)->callback &&
-			((!checktime && (*callback)->type == TARGET_TIMER_TYPE_PERIODIC) ||
-			 now >= (*callback)->when);
-
-		if (call_it)
-			target_call_timer_callback(*callback, &now);
+	for (unsigned int i = 0; i < num_due; i++) {
+		struct target_timer_callback *cb = target_timer_due[i];
 
-		if (!(*callback)->removed && (*callback)->when < target_timer_next_event_value)
-			target_timer_next_event_value = (*callback)->when;
+		/* unregistered by a callback invoked earlier in this pass */
+		if (cb->removed)
+			continue;
 
-		callback = &(*callback)->next;
+		if (target_call_timer_callback(cb, &now) != ERROR_OK && !cb->removed) {
+			LOG_ERROR("Out of memory, dropping timer callback");
+			target_unregister_timer_callback(cb->callback, cb->priv);
+		}
 	}
 
+	target_timer_free_removed();
+
+	/* Default to a value that's a ways into the future, unless a
+	 * callback wants to be called sooner. */
+	target_timer_next_event_value = now + 1000;
+	if (target_timer_heap_len && target_timer_heap[0]->when < target_timer_next_event_value)
+		target_timer_next_event_value = target_timer_heap[0]->when;
+
 	callback_processing = false;
 	return ERROR_OK;
 }
@@ -2212,6 +2384,8 @@ uint32_t target_get_working_area_avail(struct target *target)
 
 static void target_destroy(struct target *target)
 {
+	register_cache_index_free(target->reg_cache);
+
 	if (target->type->deinit_target)
 		target->type->deinit_target(target);
 
@@ -2230,6 +2404,8 @@ static void target_destroy(struct target *target)
 	}
 
 	target_free_all_working_areas(target);
+	target_memcache_free(target);
+	breakpoint_index_free(target);
 
 	/* release the targets SMP list */
 	if (target->smp) {
@@ -2272,6 +2448,16 @@ void target_quit(void)
 		pt = t;
 	}
 	target_timer_callbacks = NULL;
+	target_timer_removed_count = 0;
+
+	free(target_timer_heap);
+	target_timer_heap = NULL;
+	free(target_timer_due);
+	target_timer_due = NULL;
+	target_timer_heap_len = 0;
+	target_timer_heap_size = 0;
+
+	free_fastload();
 
 	for (struct target *target = all_targets; target;) {
 		struct target *tmp;
@@ -2388,6 +2574,7 @@ int target_write_buffer(struct target *target, target_addr_t address, uint32_t s
 		return ERROR_FAIL;
 	}
 
+	target_memcache_invalidate(target);
 	return target->type->write_buffer(target, address, size, buffer);
 }
 
@@ -2872,6 +3059,57 @@ COMMAND_HANDLER(handle_targets_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_timer_stats_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		for (struct target_timer_callback *c = target_timer_callbacks; c; c = c->next) {
+			c->run_count = 0;
+			c->run_time_us = 0;
+			c->max_run_time_us = 0;
+			c->overruns = 0;
+		}
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "Callback           Priv               Type     Period   "
+			"    Runs   Total ms     Max us   Overruns");
+	for (struct target_timer_callback *c = target_timer_callbacks; c; c = c->next) {
+		if (c->removed)
+			continue;
+
+		/* keep columns lined up to match the headers above */
+		command_print(CMD, "%-18p %-18p %-8s %6u ms %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64,
+				(void *)c->callback,
+				c->priv,
+				c->type == TARGET_TIMER_TYPE_PERIODIC ? "periodic" : "oneshot",
+				c->time_ms,
+				c->run_count,
+				c->run_time_us / 1000,
+				c->max_run_time_us,
+				c->overruns);
+	}
+
+	return ERROR_OK;
+}
+
+static const struct command_registration timer_command_handlers[] = {
+	{
+		.name = "stats",
+		.handler = handle_timer_stats_command,
+		.mode = COMMAND_ANY,
+		.help = "show run count, run time and overruns of the timer "
+			"callbacks, or reset the statistics",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 /* every 300ms we check for reset & powerdropout and issue a "reset halt" if so. */
 
 static int power_dropout;
@@ -3717,11 +3955,15 @@ COMMAND_HANDLER(handle_dump_image_command)
 	COMMAND_PARSE_ADDRESS(CMD_ARGV[1], address);
 	COMMAND_PARSE_ADDRESS(CMD_ARGV[2], size);
 
-	uint32_t buf_size = (size > 4096) ? 4096 : size;
+	/* large enough for the adapters to queue long transfers */
+	uint32_t buf_size = MIN(size, 64 * 1024);
 	buffer = malloc(buf_size);
 	if (!buffer)
 		return ERROR_FAIL;
 
+	target_addr_t total = size;
+	int64_t next_report = timeval_ms() + 2000;
+
 	retval = fileio_open(&fileio, CMD_ARGV[0], FILEIO_WRITE, FILEIO_BINARY);
 	if (retval != ERROR_OK) {
 		free(buffer);
@@ -3740,9 +3982,23 @@ COMMAND_HANDLER(handle_dump_image_command)
 		retval = fileio_write(fileio, this_run_size, buffer, &size_written);
 		if (retval != ERROR_OK)
 			break;
+		if (size_written != this_run_size) {
+			LOG_ERROR("Could not write file");
+			retval = ERROR_FAIL;
+			break;
+		}
 
 		size -= this_run_size;
 		address += this_run_size;
+
+		keep_alive();
+		if (size && timeval_ms() >= next_report &&
+				duration_measure(&bench) == ERROR_OK) {
+			next_report = timeval_ms() + 2000;
+			LOG_INFO("dumped %" PRIu64 " of %" PRIu64 " bytes (%0.3f KiB/s)",
+					(uint64_t)(total - size), (uint64_t)total,
+					duration_kbps(&bench, total - size));
+		}
 	}
 
 	free(buffer);
@@ -3750,11 +4006,10 @@ COMMAND_HANDLER(handle_dump_image_command)
 	if ((retval == ERROR_OK) && (duration_measure(&bench) == ERROR_OK)) {
 		size_t filesize;
 		retval = fileio_size(fileio, &filesize);
-		if (retval != ERROR_OK)
-			return retval;
-		command_print(CMD,
-				"dumped %zu bytes in %fs (%0.3f KiB/s)", filesize,
-				duration_elapsed(&bench), duration_kbps(&bench, filesize));
+		if (retval == ERROR_OK)
+			command_print(CMD,
+					"dumped %zu bytes in %fs (%0.3f KiB/s)", filesize,
+					duration_elapsed(&bench), duration_kbps(&bench, filesize));
 	}
 
 	retvaltemp = fileio_close(fileio);
@@ -3988,6 +4243,51 @@ static int handle_bp_command_set(struct command_invocation *cmd,
 	return retval;
 }
 
+/* set breakpoints at each address of a Tcl list, all or none of them */
+static int handle_bp_command_set_list(struct command_invocation *cmd,
+		const char *list, uint32_t length, int hw)
+{
+	struct target *target = get_current_target(cmd->ctx);
+	Jim_Interp *interp = cmd->ctx->interp;
+	int retval = ERROR_OK;
+
+	Jim_Obj *list_obj = Jim_NewStringObj(interp, list, -1);
+	Jim_IncrRefCount(list_obj);
+
+	int count = Jim_ListLength(interp, list_obj);
+	target_addr_t *addrs = NULL;
+	if (count <= 0) {
+		retval = ERROR_COMMAND_SYNTAX_ERROR;
+		goto out;
+	}
+
+	addrs = malloc(count * sizeof(*addrs));
+	if (!addrs) {
+		LOG_ERROR("Out of memory");
+		retval = ERROR_FAIL;
+		goto out;
+	}
+
+	for (int i = 0; i < count; i++) {
+		const char *word = Jim_String(Jim_ListGetIndex(interp, list_obj, i));
+		if (parse_target_addr(word, &addrs[i]) != ERROR_OK) {
+			command_print(cmd, "invalid address: %s", word);
+			retval = ERROR_COMMAND_ARGUMENT_INVALID;
+			goto out;
+		}
+	}
+
+	retval = breakpoint_add_batch(target, addrs, count, length, hw);
+	/* error is always logged in breakpoint_add(), do not print it again */
+	if (retval == ERROR_OK)
+		command_print(cmd, "%d breakpoints set", count);
+
+out:
+	free(addrs);
+	Jim_DecrRefCount(interp, list_obj);
+	return retval;
+}
+
 COMMAND_HANDLER(handle_bp_command)
 {
 	target_addr_t addr;
@@ -4001,15 +4301,19 @@ COMMAND_HANDLER(handle_bp_command)
 
 		case 2:
 			asid = 0;
-			COMMAND_PARSE_ADDRESS(CMD_ARGV[0], addr);
 			COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], length);
+			if (strpbrk(CMD_ARGV[0], " \t\r\n"))
+				return handle_bp_command_set_list(CMD, CMD_ARGV[0], length, hw);
+			COMMAND_PARSE_ADDRESS(CMD_ARGV[0], addr);
 			return handle_bp_command_set(CMD, addr, asid, length, hw);
 
 		case 3:
 			if (strcmp(CMD_ARGV[2], "hw") == 0) {
 				hw = BKPT_HARD;
-				COMMAND_PARSE_ADDRESS(CMD_ARGV[0], addr);
 				COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], length);
+				if (strpbrk(CMD_ARGV[0], " \t\r\n"))
+					return handle_bp_command_set_list(CMD, CMD_ARGV[0], length, hw);
+				COMMAND_PARSE_ADDRESS(CMD_ARGV[0], addr);
 				asid = 0;
 				return handle_bp_command_set(CMD, addr, asid, length, hw);
 			} else if (strcmp(CMD_ARGV[2], "hw_ctx") == 0) {
@@ -4034,20 +4338,36 @@ COMMAND_HANDLER(handle_bp_command)
 
 COMMAND_HANDLER(handle_rbp_command)
 {
-	if (CMD_ARGC != 1)
+	if (CMD_ARGC < 1)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
 	struct target *target = get_current_target(CMD_CTX);
 
 	if (!strcmp(CMD_ARGV[0], "all")) {
+		if (CMD_ARGC != 1)
+			return ERROR_COMMAND_SYNTAX_ERROR;
 		breakpoint_remove_all(target);
-	} else {
-		target_addr_t addr;
-		COMMAND_PARSE_ADDRESS(CMD_ARGV[0], addr);
+		return ERROR_OK;
+	}
+
+	target_addr_t *addrs = malloc(CMD_ARGC * sizeof(*addrs));
+	if (!addrs) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
 
-		breakpoint_remove(target, addr);
+	for (unsigned int i = 0; i < CMD_ARGC; i++) {
+		int retval = parse_target_addr(CMD_ARGV[i], &addrs[i]);
+		if (retval != ERROR_OK) {
+			command_print(CMD, "invalid address: %s", CMD_ARGV[i]);
+			free(addrs);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
 	}
 
+	breakpoint_remove_batch(target, addrs, CMD_ARGC);
+	free(addrs);
+
 	return ERROR_OK;
 }
 
@@ -5659,6 +5979,7 @@ COMMAND_HANDLER(handle_target_examine)
 	}
 
 	int retval = target->type->examine(target);
+	register_cache_changed();
 	if (retval != ERROR_OK) {
 		target_reset_examined(target);
 		return retval;
@@ -6054,6 +6375,9 @@ static const struct command_registration target_instance_command_handlers[] = {
 		.help = "invoke handler for specified event",
 		.usage = "event_name",
 	},
+	{
+		.chain = target_memcache_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -6472,11 +6796,11 @@ static const struct command_registration target_subcommand_handlers[] = {
 	COMMAND_REGISTRATION_DONE
 };
 
+/* a run of contiguous image data, staged in host memory */
 struct fast_load {
 	target_addr_t address;
 	uint8_t *data;
-	int length;
-
+	uint32_t length;
 };
 
 static int fastload_num;
@@ -6490,11 +6814,29 @@ static void free_fastload(void)
 		free(fastload);
 		fastload = NULL;
 	}
+	fastload_num = 0;
+}
+
+/* the part of an image section within the address limits */
+struct fast_load_section {
+	unsigned int section;
+	uint32_t offset;
+	target_addr_t address;
+	uint32_t length;
+};
+
+static int fast_load_section_compare(const void *a, const void *b)
+{
+	const struct fast_load_section *sa = a;
+	const struct fast_load_section *sb = b;
+
+	if (sa->address < sb->address)
+		return -1;
+	return sa->address > sb->address;
 }
 
 COMMAND_HANDLER(handle_fast_load_image_command)
 {
-	uint8_t *buffer;
 	size_t buf_cnt;
 	uint32_t image_size;
 	target_addr_t min_address = 0;
@@ -6514,71 +6856,97 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 	if (retval != ERROR_OK)
 		return retval;
 
-	image_size = 0x0;
-	retval = ERROR_OK;
-	fastload_num = image.num_sections;
-	fastload = malloc(sizeof(struct fast_load)*image.num_sections);
-	if (!fastload) {
+	/* a new image replaces the one staged before */
+	free_fastload();
+
+	struct fast_load_section *sections = calloc(image.num_sections, sizeof(*sections));
+	fastload = calloc(image.num_sections, sizeof(*fastload));
+	if (!sections || !fastload) {
 		command_print(CMD, "out of memory");
+		free(sections);
+		free_fastload();
 		image_close(&image);
 		return ERROR_FAIL;
 	}
-	memset(fastload, 0, sizeof(struct fast_load)*image.num_sections);
+
+	unsigned int num_sections = 0;
 	for (unsigned int i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (!buffer) {
-			command_print(CMD, "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			retval = ERROR_FAIL;
-			break;
-		}
+		target_addr_t base = image.sections[i].base_address;
+		uint32_t size = image.sections[i].size;
+		uint32_t offset = 0;
+		uint32_t length = size;
 
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
-			break;
+		/* DANGER!!! beware of unsigned comparison here!!! */
+
+		if (!size || base + size <= min_address || base >= max_address)
+			continue;
+
+		if (base < min_address) {
+			/* clip addresses below */
+			offset += min_address - base;
+			length -= offset;
 		}
 
-		uint32_t offset = 0;
-		uint32_t length = buf_cnt;
+		if (base + size > max_address)
+			length -= (base + size) - max_address;
 
-		/* DANGER!!! beware of unsigned comparison here!!! */
+		sections[num_sections].section = i;
+		sections[num_sections].offset = offset;
+		sections[num_sections].address = base + offset;
+		sections[num_sections].length = length;
+		num_sections++;
+	}
 
-		if ((image.sections[i].base_address + buf_cnt >= min_address) &&
-				(image.sections[i].base_address < max_address)) {
-			if (image.sections[i].base_address < min_address) {
-				/* clip addresses below */
-				offset += min_address-image.sections[i].base_address;
-				length -= offset;
-			}
+	/* sections following each other are staged as one run, each section
+	 * being read in place, so that they are written in a single transfer */
+	qsort(sections, num_sections, sizeof(*sections), fast_load_section_compare);
 
-			if (image.sections[i].base_address + buf_cnt > max_address)
-				length -= (image.sections[i].base_address + buf_cnt)-max_address;
+	image_size = 0x0;
+	for (unsigned int first = 0, last; first < num_sections; first = last) {
+		struct fast_load *run = &fastload[fastload_num];
+		uint32_t run_length = sections[first].length;
 
-			fastload[i].address = image.sections[i].base_address + offset;
-			fastload[i].data = malloc(length);
-			if (!fastload[i].data) {
-				free(buffer);
-				command_print(CMD, "error allocating buffer for section (%" PRIu32 " bytes)",
-							  length);
-				retval = ERROR_FAIL;
+		for (last = first + 1; last < num_sections; last++) {
+			if (sections[last].address != sections[first].address + run_length ||
+					sections[last].length > UINT32_MAX - run_length)
 				break;
-			}
-			memcpy(fastload[i].data, buffer + offset, length);
-			fastload[i].length = length;
+			run_length += sections[last].length;
+		}
 
-			image_size += length;
-			command_print(CMD, "%u bytes written at address 0x%8.8x",
-						  (unsigned int)length,
-						  ((unsigned int)(image.sections[i].base_address + offset)));
+		run->address = sections[first].address;
+		run->data = malloc(run_length);
+		if (!run->data) {
+			command_print(CMD, "error allocating buffer for section (%" PRIu32 " bytes)",
+						  run_length);
+			retval = ERROR_FAIL;
+			break;
 		}
+		fastload_num++;
 
-		free(buffer);
+		for (unsigned int i = first; i < last; i++) {
+			retval = image_read_section(&image, sections[i].section, sections[i].offset,
+					sections[i].length, run->data + run->length, &buf_cnt);
+			if (retval != ERROR_OK)
+				break;
+
+			command_print(CMD, "%u bytes written at address " TARGET_ADDR_FMT,
+						  (unsigned int)buf_cnt, sections[i].address);
+			run->length += buf_cnt;
+			image_size += buf_cnt;
+
+			/* a short read ends the run */
+			if (buf_cnt < sections[i].length) {
+				last = i + 1;
+				break;
+			}
+		}
+		if (retval != ERROR_OK)
+			break;
 	}
 
 	if ((retval == ERROR_OK) && (duration_measure(&bench) == ERROR_OK)) {
-		command_print(CMD, "Loaded %" PRIu32 " bytes "
-				"in %fs (%0.3f KiB/s)", image_size,
+		command_print(CMD, "Loaded %" PRIu32 " bytes in %u runs "
+				"in %fs (%0.3f KiB/s)", image_size, (unsigned int)fastload_num,
 				duration_elapsed(&bench), duration_kbps(&bench, image_size));
 
 		command_print(CMD,
@@ -6586,6 +6954,7 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 				"You can issue a 'fast_load' to finish loading.");
 	}
 
+	free(sections);
 	image_close(&image);
 
 	if (retval != ERROR_OK)
@@ -6602,23 +6971,27 @@ COMMAND_HANDLER(handle_fast_load_command)
 		LOG_ERROR("No image in memory");
 		return ERROR_FAIL;
 	}
-	int i;
-	int64_t ms = timeval_ms();
-	int size = 0;
+
+	struct target *target = get_current_target(CMD_CTX);
+	struct duration bench;
+	uint32_t size = 0;
 	int retval = ERROR_OK;
-	for (i = 0; i < fastload_num; i++) {
-		struct target *target = get_current_target(CMD_CTX);
-		command_print(CMD, "Write to 0x%08x, length 0x%08x",
-					  (unsigned int)(fastload[i].address),
-					  (unsigned int)(fastload[i].length));
-		retval = target_write_buffer(target, fastload[i].address, fastload[i].length, fastload[i].data);
+
+	duration_start(&bench);
+	for (int i = 0; i < fastload_num; i++) {
+		command_print(CMD, "Write to " TARGET_ADDR_FMT ", length 0x%08" PRIx32,
+					  fastload[i].address, fastload[i].length);
+		/* the target splits the run in its largest aligned accesses */
+		retval = target_write_buffer(target, fastload[i].address, fastload[i].length,
+				fastload[i].data);
 		if (retval != ERROR_OK)
 			break;
 		size += fastload[i].length;
+		keep_alive();
 	}
-	if (retval == ERROR_OK) {
-		int64_t after = timeval_ms();
-		command_print(CMD, "Loaded image %f kBytes/s", (float)(size/1024.0)/((float)(after-ms)/1000.0));
+	if (retval == ERROR_OK && duration_measure(&bench) == ERROR_OK) {
+		command_print(CMD, "Loaded image %" PRIu32 " bytes in %fs (%0.3f KiB/s)",
+				size, duration_elapsed(&bench), duration_kbps(&bench, size));
 	}
 	return retval;
 }
@@ -6639,6 +7012,13 @@ static const struct command_registration target_command_handlers[] = {
 		.chain = target_subcommand_handlers,
 		.usage = "",
 	},
+	{
+		.name = "timer",
+		.mode = COMMAND_ANY,
+		.help = "timer callback commands",
+		.chain = timer_command_handlers,
+		.usage = "",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -7032,8 +7412,8 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.name = "rbp",
 		.handler = handle_rbp_command,
 		.mode = COMMAND_EXEC,
-		.help = "remove breakpoint",
-		.usage = "'all' | address",
+		.help = "remove breakpoints",
+		.usage = "'all' | address [address ...]",
 	},
 	{
 		.name = "wp",
@@ -157,6 +157,7 @@ struct target {
 	enum target_state state;			/* the current backend-state (running, halted, ...) */
 	struct reg_cache *reg_cache;		/* the first register cache of the target (core regs) */
 	struct breakpoint *breakpoints;		/* list of breakpoints */
+	struct breakpoint_index *breakpoint_index;	/* breakpoints sorted by address */
 	struct watchpoint *watchpoints;		/* list of watchpoints */
 	struct trace *trace_info;			/* generic trace information */
 	struct debug_msg_receiver *dbgmsg;	/* list of debug message receivers */
@@ -184,6 +185,7 @@ struct target {
 	bool rtos_auto_detect;				/* A flag that indicates that the RTOS has been specified as "auto"
 										 * and must be detected when symbols are offered */
 	struct backoff_timer backoff;
+	struct target_memcache *memcache;	/* optional cache of memory reads */
 	int smp;							/* Unique non-zero number for each SMP group */
 	struct list_head *smp_targets;		/* list all targets in this smp group/cluster
 										 * The head of the list is shared between the
@@ -334,6 +336,12 @@ struct target_timer_callback {
 	bool removed;
 	int64_t when;	/* output of timeval_ms() */
 	void *priv;
+	unsigned int heap_index;	/* position in the deadline heap */
+	/* statistics, see 'timer stats' */
+	uint64_t run_count;
+	uint64_t run_time_us;
+	uint64_t max_run_time_us;
+	uint64_t overruns;
 	struct target_timer_callback *next;
 };
 
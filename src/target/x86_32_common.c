@@ -1281,6 +1281,7 @@ void x86_32_common_reset_breakpoints_watchpoints(struct target *t)
 		free(t->breakpoints);
 		t->breakpoints = next_b;
 	}
+	breakpoint_list_changed(t);
 
 	while (t->watchpoints) {
 		next_w = t->watchpoints->next;